@@ -0,0 +1,393 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "scene_parser.hpp"
+#include "camera.hpp"
+#include "curve.hpp"
+#include "group.hpp"
+#include "light.hpp"
+#include "mesh.hpp"
+#include "ppm.hpp"
+#include "random.hpp"
+#include "revsurface.hpp"
+#include "sphere.hpp"
+#include "triangle.hpp"
+
+// Throughput benchmarks for the intersection, photon map and sampling
+// kernels.  Every workload is generated from a fixed seed and runs a
+// fixed amount of work single-threaded, so numbers are comparable across
+// builds.  The checksum of each kernel changes only if its results do.
+
+namespace {
+
+struct BenchResult {
+    std::string name;
+    std::string unit;
+    long long items;
+    double seconds;
+    double checksum;
+};
+
+struct BenchConfig {
+    unsigned seed = 42;
+    int scale = 1;
+    std::string scene;
+};
+
+class Stopwatch {
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+float uniform(std::mt19937 &rng, float lo, float hi) {
+    return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+Vector3f uniformVector(std::mt19937 &rng, float lo, float hi) {
+    float x = uniform(rng, lo, hi);
+    float y = uniform(rng, lo, hi);
+    float z = uniform(rng, lo, hi);
+    return Vector3f(x, y, z);
+}
+
+Vector3f uniformDirection(std::mt19937 &rng) {
+    Vector3f d;
+    do {
+        d = uniformVector(rng, -1, 1);
+    } while (d.squaredLength() > 1 || d.squaredLength() < 1e-4);
+    return d.normalized();
+}
+
+// Rays starting on a sphere of the given radius, aimed at random points
+// inside the unit cube around the origin.
+std::vector<Ray> makeRays(std::mt19937 &rng, int num, float radius) {
+    std::vector<Ray> rays;
+    rays.reserve(num);
+    for (int i = 0; i < num; ++i) {
+        Vector3f origin = radius * uniformDirection(rng);
+        Vector3f target = uniformVector(rng, -1, 1);
+        rays.emplace_back(origin, (target - origin).normalized());
+    }
+    return rays;
+}
+
+// Unit sphere tessellated into 2 * rings * segments triangles.
+Mesh *makeSphereMesh(Material *material, int rings, int segments) {
+    Mesh *mesh = new Mesh(material);
+    const float pi = acos(-1.0);
+    for (int i = 0; i <= rings; ++i) {
+        float theta = pi * i / rings;
+        for (int j = 0; j < segments; ++j) {
+            float phi = 2 * pi * j / segments;
+            mesh->v.emplace_back(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+        }
+    }
+    for (int i = 0; i < rings; ++i) {
+        for (int j = 0; j < segments; ++j) {
+            int a = i * segments + j, b = i * segments + (j + 1) % segments;
+            mesh->t.emplace_back(a, b, b + segments);
+            mesh->t.emplace_back(a, b + segments, a + segments);
+        }
+    }
+    return mesh;
+}
+
+BenchResult benchTriangle(const BenchConfig &config, Material *material) {
+    std::mt19937 rng(config.seed);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 256; ++i) {
+        Vector3f a = uniformVector(rng, -1, 1);
+        triangles.emplace_back(a, a + uniformVector(rng, -0.5, 0.5), a + uniformVector(rng, -0.5, 0.5), material);
+    }
+    std::vector<Ray> rays = makeRays(rng, 4000 * config.scale, 3);
+    double checksum = 0;
+    Stopwatch watch;
+    for (const Ray &r: rays) {
+        Hit h;
+        for (Triangle &triangle: triangles) {
+            triangle.intersect(r, h, 1e-4);
+        }
+        checksum += h.getT() < 1e37 ? h.getT() : 0;
+    }
+    double seconds = watch.seconds();
+    return {"triangle_intersect", "tests", (long long) (rays.size() * triangles.size()), seconds, checksum};
+}
+
+BenchResult benchSphere(const BenchConfig &config, Material *material) {
+    std::mt19937 rng(config.seed);
+    std::vector<Sphere> spheres;
+    for (int i = 0; i < 256; ++i) {
+        spheres.emplace_back(uniformVector(rng, -1, 1), uniform(rng, 0.05, 0.3), material);
+    }
+    std::vector<Ray> rays = makeRays(rng, 4000 * config.scale, 3);
+    double checksum = 0;
+    Stopwatch watch;
+    for (const Ray &r: rays) {
+        Hit h;
+        for (Sphere &sphere: spheres) {
+            sphere.intersect(r, h, 1e-4);
+        }
+        checksum += h.getT() < 1e37 ? h.getT() : 0;
+    }
+    double seconds = watch.seconds();
+    return {"sphere_intersect", "tests", (long long) (rays.size() * spheres.size()), seconds, checksum};
+}
+
+void benchKDTree(const BenchConfig &config, Material *material, std::vector<BenchResult> &results) {
+    std::mt19937 rng(config.seed);
+    Mesh *mesh = makeSphereMesh(material, 200, 200);
+    Stopwatch buildWatch;
+    mesh->buildKDTree();
+    results.push_back({"kdtree_build", "triangles", (long long) mesh->t.size(), buildWatch.seconds(), 0});
+
+    std::vector<Ray> rays = makeRays(rng, 20000 * config.scale, 3);
+    double checksum = 0;
+    Stopwatch watch;
+    for (const Ray &r: rays) {
+        Hit h;
+        if (mesh->intersect(r, h, 1e-4)) {
+            checksum += h.getT();
+        }
+    }
+    results.push_back({"kdtree_intersect", "rays", (long long) rays.size(), watch.seconds(), checksum});
+    delete mesh;
+}
+
+void benchPhotonMap(const BenchConfig &config, std::vector<BenchResult> &results) {
+    std::mt19937 rng(config.seed);
+    // Half the photons uniform, half clustered on a few surfaces.
+    std::vector<Photon> photons(200000 * config.scale);
+    for (int i = 0; i < (int) photons.size(); ++i) {
+        Photon &p = photons[i];
+        p.pos = uniformVector(rng, -5, 5);
+        if (i % 2) {
+            p.pos[i % 3] = (float) (i % 5 - 2);
+            p.normal[i % 3] = 1;
+        }
+        p.dir = uniformDirection(rng);
+        p.power = uniformVector(rng, 0, 1);
+    }
+    PhotonKDTree *root = new PhotonKDTree;
+    Stopwatch buildWatch;
+    root->build(photons.begin(), photons.end(), 0);
+    results.push_back({"photon_build", "photons", (long long) photons.size(), buildWatch.seconds(), 0});
+
+    std::vector<Vector3f> queries;
+    for (int i = 0; i < 20000 * config.scale; ++i) {
+        queries.push_back(uniformVector(rng, -5, 5));
+    }
+    long long found = 0;
+    std::vector<Photon> collected;
+    Stopwatch watch;
+    for (const Vector3f &q: queries) {
+        collected.clear();
+        root->collect(q, 0.3, collected);
+        found += collected.size();
+    }
+    results.push_back({"photon_collect", "queries", (long long) queries.size(), watch.seconds(), (double) found});
+
+    // Same queries on the +x surfaces
+    found = 0;
+    Stopwatch normalWatch;
+    for (const Vector3f &q: queries) {
+        collected.clear();
+        root->collect(q, 0.3, collected, Vector3f(1, 0, 0));
+        found += collected.size();
+    }
+    results.push_back({"photon_collect_normal", "queries", (long long) queries.size(), normalWatch.seconds(), (double) found});
+    delete root;
+}
+
+BenchResult benchRevSurface(const BenchConfig &config, Material *material) {
+    std::mt19937 rng(config.seed);
+    // Profile of the vase in testcases/myscene_final.txt.
+    std::vector<Vector3f> controls = {
+        Vector3f(-2, 3, 0), Vector3f(-4, 1, 0), Vector3f(0, 0, 0), Vector3f(-2, -2, 0)
+    };
+    RevSurface surface(new BezierCurve(controls), material);
+    std::vector<Ray> rays;
+    for (int i = 0; i < 20000 * config.scale; ++i) {
+        Vector3f origin = 8 * uniformDirection(rng);
+        Vector3f target = Vector3f(uniform(rng, -3, 3), uniform(rng, -2, 3), uniform(rng, -3, 3));
+        rays.emplace_back(origin, (target - origin).normalized());
+    }
+    double checksum = 0;
+    Stopwatch watch;
+    for (const Ray &r: rays) {
+        Hit h;
+        if (surface.intersect(r, h, 1e-2)) {
+            checksum += h.getT();
+        }
+    }
+    double seconds = watch.seconds();
+    return {"revsurface_intersect", "rays", (long long) rays.size(), seconds, checksum};
+}
+
+// Gather shading of batches of photons, one result per shading kernel.
+void benchShade(const BenchConfig &config, std::vector<BenchResult> &results) {
+    std::mt19937 rng(config.seed);
+    std::vector<Photon> photons(64);
+    for (Photon &p: photons) {
+        p.dir = uniformDirection(rng);
+        p.power = uniformVector(rng, 0, 1);
+    }
+    Material diffuse(Vector3f(0.8, 0.8, 0.8));
+    Material phongInt(Vector3f(0.5, 0.5, 0.5), Vector3f(0.5, 0.5, 0.5), 20);
+    Material phong(Vector3f(0.5, 0.5, 0.5), Vector3f(0.5, 0.5, 0.5), 2.5);
+    const char *names[3] = {"shade_diffuse", "shade_phong_int", "shade_phong"};
+    Material *materials[3] = {&diffuse, &phongInt, &phong};
+    int batches = 20000 * config.scale;
+    for (int m = 0; m < 3; ++m) {
+        Vector3f normal = Vector3f(1, 2, 3).normalized(), sum = Vector3f::ZERO;
+        Stopwatch watch;
+        for (int i = 0; i < batches; ++i) {
+            Vector3f view = Vector3f(i % 7 - 3, -5, i % 5 - 2).normalized();
+            sum += materials[m]->ShadeBatch(view, normal, photons.data(), (int) photons.size());
+        }
+        results.push_back({names[m], "photons", (long long) batches * (long long) photons.size(), watch.seconds(), sum.length()});
+    }
+}
+
+void benchSampling(const BenchConfig &config, std::vector<BenchResult> &results) {
+    seedRandom(config.seed);
+    int num = 1000000 * config.scale;
+    Vector3f normal = Vector3f(1, 2, 3).normalized(), sum = Vector3f::ZERO;
+    Stopwatch diffuseWatch;
+    for (int i = 0; i < num; ++i) {
+        sum += randomDiffuse(normal);
+    }
+    results.push_back({"sample_diffuse", "samples", num, diffuseWatch.seconds(), sum.length()});
+
+    Vector3f color(1, 1, 1);
+    AreaLight light(Vector3f(0, 0, 5), Vector3f(0, 0, -1), Vector3f(1, 0, 0), Vector3f(0, 1, 0), 2, 2, color);
+    sum = Vector3f::ZERO;
+    Stopwatch lightWatch;
+    for (int i = 0; i < num; ++i) {
+        sum += light.generate().first.getDirection();
+    }
+    results.push_back({"sample_area_light", "samples", num, lightWatch.seconds(), sum.length()});
+
+    LensCamera camera(Vector3f(-12, 0, 0), Vector3f(1, 0, 0), Vector3f(0, 0, 1), 640, 640, 1.0, 0.1, 10);
+    sum = Vector3f::ZERO;
+    Stopwatch cameraWatch;
+    for (int i = 0; i < num; ++i) {
+        sum += camera.generateRay(Vector2f(i % 640, i / 640 % 640)).getDirection();
+    }
+    results.push_back({"sample_lens_camera", "rays", num, cameraWatch.seconds(), sum.length()});
+}
+
+// Primary rays and photon paths through a real scene.  False if the scene
+// has no camera or no group to trace.
+bool benchScene(const BenchConfig &config, std::vector<BenchResult> &results) {
+    Stopwatch parseWatch;
+    SceneParser parser(config.scene.c_str());
+    results.push_back({"scene_parse", "scenes", 1, parseWatch.seconds(), 0});
+    Camera *camera = parser.getCamera();
+    Group *group = parser.getGroup();
+    if (camera == nullptr || group == nullptr) {
+        printf("Scene %s has no %s\n", config.scene.c_str(), camera == nullptr ? "camera" : "Group");
+        return false;
+    }
+
+    seedRandom(config.seed);
+    long long rays = 0;
+    double checksum = 0;
+    Stopwatch rayWatch;
+    for (int x = 0; x < camera->getWidth(); ++x) {
+        for (int y = 0; y < camera->getHeight(); ++y) {
+            Hit h;
+            Ray r = camera->generateRay(Vector2f(x, y));
+            if (group->intersect(r, h, minTime)) {
+                h.finalize(r);
+                checksum += h.getT();
+            }
+            ++rays;
+        }
+    }
+    results.push_back({"scene_primary_rays", "rays", rays, rayWatch.seconds(), checksum});
+
+    seedRandom(config.seed);
+    long long photons = 0;
+    Stopwatch photonWatch;
+    for (int li = 0; li < parser.getNumLights(); ++li) {
+        Light *light = parser.getLight(li);
+        for (int i = 0; i < 20000 * config.scale; ++i) {
+            std::pair<Ray, Vector3f> generation = light->generate();
+            std::vector<Trace> trace;
+            traceRay(group, generation.first, generation.second, 5, trace, true);
+            photons += 1 + trace.size();
+        }
+    }
+    results.push_back({"scene_photon_trace", "photons", photons, photonWatch.seconds(), (double) photons});
+    return true;
+}
+
+void writeJson(FILE *file, const BenchConfig &config, const std::vector<BenchResult> &results) {
+    fprintf(file, "{\n  \"seed\": %u,\n  \"scale\": %d,\n  \"benchmarks\": [\n", config.seed, config.scale);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"items\": %lld, \"seconds\": %.6f, "
+                      "\"items_per_second\": %.1f, \"checksum\": %.6g}%s\n",
+                r.name.c_str(), r.unit.c_str(), r.items, r.seconds,
+                r.seconds > 0 ? r.items / r.seconds : 0.0, r.checksum, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+    const char *output = nullptr;
+    for (int argNum = 1; argNum < argc; ++argNum) {
+        if (!strcmp(argv[argNum], "--seed") && argNum + 1 < argc) {
+            config.seed = (unsigned) strtoul(argv[++argNum], nullptr, 10);
+        } else if (!strcmp(argv[argNum], "--scale") && argNum + 1 < argc) {
+            config.scale = std::max(1, atoi(argv[++argNum]));
+        } else if (!strcmp(argv[argNum], "--scene") && argNum + 1 < argc) {
+            config.scene = argv[++argNum];
+        } else if (!strcmp(argv[argNum], "-o") && argNum + 1 < argc) {
+            output = argv[++argNum];
+        } else {
+            printf("Usage: ./bin/pj_bench [--seed N] [--scale N] [--scene <scene file>] [-o <json file>]\n");
+            return 1;
+        }
+    }
+
+    Material material(Vector3f(1, 1, 1));
+    std::vector<BenchResult> results;
+    results.push_back(benchTriangle(config, &material));
+    results.push_back(benchSphere(config, &material));
+    benchKDTree(config, &material, results);
+    benchPhotonMap(config, results);
+    results.push_back(benchRevSurface(config, &material));
+    benchShade(config, results);
+    benchSampling(config, results);
+    if (!config.scene.empty() && !benchScene(config, results)) {
+        return 1;
+    }
+
+    FILE *file = output != nullptr ? fopen(output, "w") : stdout;
+    if (file == nullptr) {
+        printf("Cannot open %s\n", output);
+        return 1;
+    }
+    writeJson(file, config, results);
+    if (file != stdout) {
+        fclose(file);
+    }
+    return 0;
+}
@@ -1,8 +1,13 @@
 #ifndef VECTOR_3F_H
 #define VECTOR_3F_H
 
+#include <cmath>
+
 class Vector2f;
 
+// Header-only so that the arithmetic inlines into the renderer.  Kept at
+// three packed floats, arrays of Vector3f are read and written raw.
+
 class Vector3f
 {
 public:
@@ -12,42 +17,45 @@ public:
 	static const Vector3f RIGHT;
 	static const Vector3f FORWARD;
 
-    Vector3f( float f = 0.f );
-    Vector3f( float x, float y, float z );
+    constexpr Vector3f( float f = 0.f ) : m_elements{ f, f, f } {}
+    constexpr Vector3f( float x, float y, float z ) : m_elements{ x, y, z } {}
 
 	Vector3f( const Vector2f& xy, float z );
 	Vector3f( float x, const Vector2f& yz );
 
 	// copy constructors
-    Vector3f( const Vector3f& rv );
+    Vector3f( const Vector3f& rv ) = default;
 
 	// assignment operators
-    Vector3f& operator = ( const Vector3f& rv );
+    Vector3f& operator = ( const Vector3f& rv ) = default;
 
 	// no destructor necessary
 
 	// returns the ith element
-    const float& operator [] ( int i ) const;
-    float& operator [] ( int i );
+    constexpr const float& operator [] ( int i ) const { return m_elements[ i ]; }
+    float& operator [] ( int i ) { return m_elements[ i ]; }
 
-    float& x();
-	float& y();
-	float& z();
+    float& x() { return m_elements[ 0 ]; }
+	float& y() { return m_elements[ 1 ]; }
+	float& z() { return m_elements[ 2 ]; }
 
-	float x() const;
-	float y() const;
-	float z() const;
+	constexpr float x() const { return m_elements[ 0 ]; }
+	constexpr float y() const { return m_elements[ 1 ]; }
+	constexpr float z() const { return m_elements[ 2 ]; }
 
 	Vector2f xy() const;
 	Vector2f xz() const;
 	Vector2f yz() const;
 
-	Vector3f xyz() const;
-	Vector3f yzx() const;
-	Vector3f zxy() const;
+	constexpr Vector3f xyz() const { return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 2 ] ); }
+	constexpr Vector3f yzx() const { return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 0 ] ); }
+	constexpr Vector3f zxy() const { return Vector3f( m_elements[ 2 ], m_elements[ 0 ], m_elements[ 1 ] ); }
 
 	float length() const;
-    float squaredLength() const;
+    constexpr float squaredLength() const
+    {
+        return m_elements[ 0 ] * m_elements[ 0 ] + m_elements[ 1 ] * m_elements[ 1 ] + m_elements[ 2 ] * m_elements[ 2 ];
+    }
 
 	void normalize();
 	Vector3f normalized() const;
@@ -57,16 +65,28 @@ public:
 	void negate();
 
 	// ---- Utility ----
-    operator const float* () const; // automatic type conversion for OpenGL
-    operator float* (); // automatic type conversion for OpenGL 
+    operator const float* () const { return m_elements; } // automatic type conversion for OpenGL
+    operator float* () { return m_elements; } // automatic type conversion for OpenGL 
 	void print() const;	
 
 	Vector3f& operator += ( const Vector3f& v );
 	Vector3f& operator -= ( const Vector3f& v );
     Vector3f& operator *= ( float f );
 
-    static float dot( const Vector3f& v0, const Vector3f& v1 );
-	static Vector3f cross( const Vector3f& v0, const Vector3f& v1 );
+    static constexpr float dot( const Vector3f& v0, const Vector3f& v1 )
+    {
+        return v0[ 0 ] * v1[ 0 ] + v0[ 1 ] * v1[ 1 ] + v0[ 2 ] * v1[ 2 ];
+    }
+
+	static constexpr Vector3f cross( const Vector3f& v0, const Vector3f& v1 )
+    {
+        return Vector3f
+            (
+                v0[ 1 ] * v1[ 2 ] - v0[ 2 ] * v1[ 1 ],
+                v0[ 2 ] * v1[ 0 ] - v0[ 0 ] * v1[ 2 ],
+                v0[ 0 ] * v1[ 1 ] - v0[ 1 ] * v1[ 0 ]
+            );
+    }
     
     // computes the linear interpolation between v0 and v1 by alpha \in [0,1]
 	// returns v0 * ( 1 - alpha ) * v1 * alpha
@@ -84,20 +104,117 @@ private:
 };
 
 // component-wise operators
-Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 );
+inline constexpr Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 )
+{
+    return Vector3f( v0[0] + v1[0], v0[1] + v1[1], v0[2] + v1[2] );
+}
+
+inline constexpr Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 )
+{
+    return Vector3f( v0[0] - v1[0], v0[1] - v1[1], v0[2] - v1[2] );
+}
+
+inline constexpr Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 )
+{
+    return Vector3f( v0[0] * v1[0], v0[1] * v1[1], v0[2] * v1[2] );
+}
+
+inline constexpr Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 )
+{
+    return Vector3f( v0[0] / v1[0], v0[1] / v1[1], v0[2] / v1[2] );
+}
 
 // unary negation
-Vector3f operator - ( const Vector3f& v );
+inline constexpr Vector3f operator - ( const Vector3f& v )
+{
+    return Vector3f( -v[0], -v[1], -v[2] );
+}
 
 // multiply and divide by scalar
-Vector3f operator * ( float f, const Vector3f& v );
-Vector3f operator * ( const Vector3f& v, float f );
-Vector3f operator / ( const Vector3f& v, float f );
+inline constexpr Vector3f operator * ( float f, const Vector3f& v )
+{
+    return Vector3f( v[0] * f, v[1] * f, v[2] * f );
+}
+
+inline constexpr Vector3f operator * ( const Vector3f& v, float f )
+{
+    return Vector3f( v[0] * f, v[1] * f, v[2] * f );
+}
+
+inline constexpr Vector3f operator / ( const Vector3f& v, float f )
+{
+    return Vector3f( v[0] / f, v[1] / f, v[2] / f );
+}
+
+inline constexpr bool operator == ( const Vector3f& v0, const Vector3f& v1 )
+{
+    return( v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z() );
+}
+
+inline constexpr bool operator != ( const Vector3f& v0, const Vector3f& v1 )
+{
+    return !( v0 == v1 );
+}
+
+inline float Vector3f::length() const
+{
+	return std::sqrt( squaredLength() );
+}
+
+inline void Vector3f::normalize()
+{
+	float norm = length();
+	m_elements[0] /= norm;
+	m_elements[1] /= norm;
+	m_elements[2] /= norm;
+}
+
+inline Vector3f Vector3f::normalized() const
+{
+	float norm = length();
+	return Vector3f
+		(
+			m_elements[0] / norm,
+			m_elements[1] / norm,
+			m_elements[2] / norm
+		);
+}
+
+inline void Vector3f::negate()
+{
+	m_elements[0] = -m_elements[0];
+	m_elements[1] = -m_elements[1];
+	m_elements[2] = -m_elements[2];
+}
+
+inline Vector3f& Vector3f::operator += ( const Vector3f& v )
+{
+	m_elements[ 0 ] += v.m_elements[ 0 ];
+	m_elements[ 1 ] += v.m_elements[ 1 ];
+	m_elements[ 2 ] += v.m_elements[ 2 ];
+	return *this;
+}
 
-bool operator == ( const Vector3f& v0, const Vector3f& v1 );
-bool operator != ( const Vector3f& v0, const Vector3f& v1 );
+inline Vector3f& Vector3f::operator -= ( const Vector3f& v )
+{
+	m_elements[ 0 ] -= v.m_elements[ 0 ];
+	m_elements[ 1 ] -= v.m_elements[ 1 ];
+	m_elements[ 2 ] -= v.m_elements[ 2 ];
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator *= ( float f )
+{
+	m_elements[ 0 ] *= f;
+	m_elements[ 1 ] *= f;
+	m_elements[ 2 ] *= f;
+	return *this;
+}
+
+// static
+inline Vector3f Vector3f::lerp( const Vector3f& v0, const Vector3f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
 
 #endif // VECTOR_3F_H
@@ -2,6 +2,7 @@
 #define CAMERA_H
 
 #include "ray.hpp"
+#include "random.hpp"
 #include <cstdlib>
 #include <vecmath.h>
 #include <float.h>
@@ -69,8 +70,8 @@ public:
     }
 
     virtual Ray generateRay(const Vector2f &point) override {
-        Vector2f newPoint(point[0] + 1.0 * rand() / RAND_MAX - 0.5,
-                          point[1] + 1.0 * rand() / RAND_MAX - 0.5);
+        Vector2f newPoint(point[0] + random01() - 0.5,
+                          point[1] + random01() - 0.5);
         Ray r = PerspectiveCamera::generateRay(newPoint);
         Vector3f objPoint = r.pointAtParameter(depth / Vector3f::dot(r.getDirection(), direction));
         Vector3f newCenter = randomCenter();
@@ -85,8 +86,8 @@ private:
     Vector2f randomPoint() {
         float x, y;
         do {
-            x = 2.0 * rand() / RAND_MAX - 1;
-            y = 2.0 * rand() / RAND_MAX - 1;
+            x = 2 * random01() - 1;
+            y = 2 * random01() - 1;
         } while(x * x + y * y > 1);
         return Vector2f(x, y);
     }
@@ -95,7 +96,7 @@ private:
         Vector3f dx = Vector3f::cross(direction, up).normalized();
         Vector3f dy = Vector3f::cross(direction, dx).normalized();
         Vector2f point = radius * randomPoint();
-        return center + point[0] * dx + point[1] + dy;
+        return center + point[0] * dx + point[1] * dy;
     }
 };
 
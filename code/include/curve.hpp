@@ -16,6 +16,90 @@ struct CurvePoint {
     Vector3f T; // Tangent  (unit)
 };
 
+// Curve evaluation runs inside the RevSurface Newton loop, so the
+// evaluators below keep their work arrays on the stack.
+
+// De Casteljau on controls c[0..Degree].  T is the derivative direction
+// (vertex[1] - vertex[0]) scaled by tangentScale.
+template <int Degree>
+CurvePoint deCasteljau(const Vector3f *c, float t, float tangentScale) {
+    Vector3f vertex[Degree + 1];
+    for (int i = 0; i <= Degree; ++i)
+        vertex[i] = c[i];
+    for (int degree = 1; degree < Degree; ++degree)
+        for (int pointId = 0; pointId <= Degree - degree; ++pointId)
+            vertex[pointId] = (1 - t) * vertex[pointId] + t * vertex[pointId + 1];
+    CurvePoint point;
+    point.V = (1 - t) * vertex[0] + t * vertex[1];
+    point.T = tangentScale * (vertex[1] - vertex[0]);
+    return point;
+}
+
+// Same for degrees without an instantiation, with a per-thread work array.
+inline CurvePoint deCasteljau(const Vector3f *c, int n, float t, float tangentScale) {
+    static thread_local std::vector<Vector3f> vertex;
+    vertex.assign(c, c + n);
+    for (int degree = 1; degree < n - 1; ++degree)
+        for (int pointId = 0; pointId < n - degree; ++pointId)
+            vertex[pointId] = (1 - t) * vertex[pointId] + t * vertex[pointId + 1];
+    CurvePoint point;
+    point.V = (1 - t) * vertex[0] + t * vertex[1];
+    point.T = tangentScale * (vertex[1] - vertex[0]);
+    return point;
+}
+
+typedef CurvePoint (*BezierEvaluator)(const Vector3f *c, float t, float tangentScale);
+
+// Degrees with a stack-only evaluator
+const int MAX_BEZIER_DEGREE = 30;
+
+template <int Degree>
+struct BezierEvaluators {
+    static void fill(BezierEvaluator *table) {
+        table[Degree] = &deCasteljau<Degree>;
+        BezierEvaluators<Degree - 1>::fill(table);
+    }
+};
+
+template <>
+struct BezierEvaluators<0> {
+    static void fill(BezierEvaluator *table) {
+        table[0] = nullptr;
+    }
+};
+
+inline BezierEvaluator getBezierEvaluator(int degree) {
+    static BezierEvaluator table[MAX_BEZIER_DEGREE + 1];
+    static bool filled = (BezierEvaluators<MAX_BEZIER_DEGREE>::fill(table), true);
+    (void) filled;
+    return degree <= MAX_BEZIER_DEGREE ? table[degree] : nullptr;
+}
+
+// Highest degree converted to power basis; higher Bezier degrees are
+// evaluated with de Casteljau, where the power basis loses precision.
+const int MAX_SEGMENT_DEGREE = 6;
+
+// One polynomial piece of a curve in power basis:
+// V(t) = sum coef[i] * u^i with u = (t - start) * scale.
+struct CurveSegment {
+    float start, scale;
+    int degree;
+    Vector3f coef[MAX_SEGMENT_DEGREE + 1];
+
+    CurvePoint evaluate(float t) const {
+        float u = (t - start) * scale;
+        Vector3f V = coef[degree], D = Vector3f::ZERO;
+        for (int i = degree - 1; i >= 0; --i) {
+            D = D * u + V;
+            V = V * u + coef[i];
+        }
+        CurvePoint point;
+        point.V = V;
+        point.T = D * scale;
+        return point;
+    }
+};
+
 class Curve : public Object3D {
 protected:
     std::vector<Vector3f> controls;
@@ -35,6 +119,48 @@ public:
     virtual std::pair<float, float> getRange() = 0;
     virtual CurvePoint getCurvePoint(float t) = 0;
     virtual void discretize(int resolution, std::vector<CurvePoint>& data) = 0;
+
+    // Samples such that every chord between neighbours stays within
+    // tolerance of the curve; flat stretches get few samples.
+    void discretizeAdaptive(float tolerance, std::vector<CurvePoint>& data) {
+        data.clear();
+        std::pair<float, float> range = getRange();
+        int pieces = 2 * std::max((int) segments.size(), 1);
+        CurvePoint start = getCurvePoint(range.first);
+        data.push_back(start);
+        for (int pieceId = 0; pieceId < pieces; ++pieceId) {
+            float t1 = range.first + (range.second - range.first) * (pieceId + 1) / pieces;
+            float t0 = range.first + (range.second - range.first) * pieceId / pieces;
+            CurvePoint end = getCurvePoint(t1);
+            subdivide(t0, t1, start, end, tolerance, 0, data);
+            start = end;
+        }
+        for (CurvePoint &point : data)
+            point.T.normalize();
+    }
+
+protected:
+    // Polynomial pieces in increasing parameter order, if the curve has them
+    std::vector<CurveSegment> segments;
+
+private:
+    // Appends the samples in (t0, t1], splitting while the curve midpoint
+    // is farther than tolerance from the chord.
+    void subdivide(float t0, float t1, const CurvePoint &p0, const CurvePoint &p1, float tolerance, int depth,
+                   std::vector<CurvePoint>& data) {
+        float tm = (t0 + t1) / 2;
+        CurvePoint pm = getCurvePoint(tm);
+        Vector3f chord = p1.V - p0.V;
+        float length = chord.length();
+        float dis = length > 0 ? Vector3f::cross(pm.V - p0.V, chord).length() / length : (pm.V - p0.V).length();
+        if (dis > tolerance && depth < 16) {
+            subdivide(t0, tm, p0, pm, tolerance, depth + 1, data);
+            subdivide(tm, t1, pm, p1, tolerance, depth + 1, data);
+        }
+        else {
+            data.push_back(p1);
+        }
+    }
 };
 
 class BezierCurve : public Curve {
@@ -44,20 +170,37 @@ public:
             printf("Number of control points of BezierCurve must be 3n+1!\n");
             exit(0);
         }
+        int degree = (int) points.size() - 1;
+        evaluator = getBezierEvaluator(degree);
+        if (degree <= MAX_SEGMENT_DEGREE) {
+            // a_j = C(d, j) * sum_i (-1)^(j - i) C(j, i) P_i
+            CurveSegment segment;
+            segment.start = 0;
+            segment.scale = 1;
+            segment.degree = degree;
+            for (int j = 0; j <= degree; ++j) {
+                double coef[3] = {0, 0, 0};
+                for (int i = 0; i <= j; ++i) {
+                    double c = binomial(j, i) * ((j - i) % 2 ? -1 : 1);
+                    for (int axis = 0; axis < 3; ++axis)
+                        coef[axis] += c * controls[i][axis];
+                }
+                double c = binomial(degree, j);
+                segment.coef[j] = Vector3f(c * coef[0], c * coef[1], c * coef[2]);
+            }
+            segments.push_back(segment);
+        }
     }
 
     std::pair<float, float> getRange() override { return std::make_pair(0.0, 1.0); }
 
     CurvePoint getCurvePoint(float t) override {
+        if (!segments.empty())
+            return segments[0].evaluate(t);
         int n = (int) controls.size();
-        std::vector<Vector3f> vertex(controls);
-        for (int degree = 1; degree < n - 1; ++degree)
-            for (int pointId = 0; pointId < n - degree; pointId ++ )
-                vertex[pointId] = (1 - t) * vertex[pointId] + t * vertex[pointId + 1];
-        CurvePoint point;
-        point.V = (1 - t) * vertex[0] + t * vertex[1];
-        point.T = n * (vertex[1] - vertex[0]);
-        return point;
+        if (evaluator != nullptr)
+            return evaluator(controls.data(), t, n - 1);
+        return deCasteljau(controls.data(), n, t, n - 1);
     }
 
     void discretize(int resolution, std::vector<CurvePoint>& data) override {
@@ -71,7 +214,15 @@ public:
     }
 
 protected:
+    BezierEvaluator evaluator;
 
+private:
+    static double binomial(int n, int k) {
+        double c = 1;
+        for (int i = 1; i <= k; ++i)
+            c = c * (n - k + i) / i;
+        return c;
+    }
 };
 
 class BsplineCurve : public Curve {
@@ -82,47 +233,28 @@ public:
             exit(0);
         }
         k = 3;
-        for (int knotId = 0; knotId <= (int) controls.size() + k; ++knotId)
-            knots.push_back(1.0 * knotId / ((int) controls.size() + k));
+        int n = (int) controls.size();
+        for (int knotId = 0; knotId <= n + k; ++knotId)
+            knots.push_back(1.0 * knotId / (n + k));
+        // Uniform cubic pieces in u = (t - knots[i]) * (n + k), controls P[i-3..i]
+        for (int intervalId = k; intervalId < n; ++intervalId) {
+            const Vector3f *P = &controls[intervalId - k];
+            CurveSegment segment;
+            segment.start = knots[intervalId];
+            segment.scale = n + k;
+            segment.degree = 3;
+            segment.coef[0] = (P[0] + 4 * P[1] + P[2]) / 6;
+            segment.coef[1] = (P[2] - P[0]) / 2;
+            segment.coef[2] = (P[0] - 2 * P[1] + P[2]) / 2;
+            segment.coef[3] = (3 * (P[1] - P[2]) + P[3] - P[0]) / 6;
+            segments.push_back(segment);
+        }
     }
 
     std::pair<float, float> getRange() override { return std::make_pair(knots[k], knots[controls.size()]); }
 
     CurvePoint getCurvePoint(float t) override {
-        int intervalId = getInterval(t);
-        std::vector<float> B;
-        B.push_back(1);
-        for (int degree = 1; degree < k; ++degree) {
-            for (int funId = intervalId - degree; funId <= intervalId; ++funId) {
-                if (funId == intervalId - degree)
-                    B.push_back((knots[funId + degree + 1] - t) / (knots[funId + degree + 1] - knots[funId + 1]) * B[degree - 1]);
-                else if (funId == intervalId)
-                    B[0] = (t - knots[funId]) / (knots[funId + degree] - knots[funId]) * B[0];
-                else
-                    B[intervalId - funId] = (t - knots[funId]) / (knots[funId + degree] - knots[funId]) * B[intervalId - funId]
-                                          + (knots[funId + degree + 1] - t) / (knots[funId + degree + 1] - knots[funId + 1]) * B[intervalId - funId - 1];
-            }
-        }
-        CurvePoint point;
-        point.V = Vector3f::ZERO;
-        point.T = Vector3f::ZERO;
-        for (int funId = intervalId - k; funId <= intervalId; ++funId) {
-            if (funId == intervalId - k) {
-                point.V += controls[funId] * ((knots[funId + k + 1] - t) / (knots[funId + k + 1] - knots[funId + 1]) * B[2]);
-                point.T -= controls[funId] * (k / (knots[funId + k + 1] - knots[funId + 1]) * B[2]);
-            }
-            else if (funId == intervalId) {
-                point.V += controls[funId] * ((t - knots[funId]) / (knots[funId + k] - knots[funId]) * B[0]);
-                point.T += controls[funId] * (k / (knots[funId + k] - knots[funId]) * B[0]);
-            }
-            else {
-                point.V += controls[funId] * ((t - knots[funId]) / (knots[funId + k] - knots[funId]) * B[intervalId - funId]
-                          + (knots[funId + k + 1] - t) / (knots[funId + k + 1] - knots[funId + 1]) * B[intervalId - funId - 1]);
-                point.T += controls[funId] * (k / (knots[funId + k] - knots[funId]) * B[intervalId - funId]
-                          - k / (knots[funId + k + 1] - knots[funId + 1]) * B[intervalId - funId - 1]);
-            }
-        }
-        return point;
+        return segments[getInterval(t) - k].evaluate(t);
     }
 
     void discretize(int resolution, std::vector<CurvePoint>& data) override {
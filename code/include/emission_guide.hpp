@@ -0,0 +1,49 @@
+#ifndef EMISSION_GUIDE_H
+#define EMISSION_GUIDE_H
+
+#include <utility>
+#include <vector>
+#include <vecmath.h>
+#include "light.hpp"
+#include "photon.hpp"
+
+// Histogram-guided photon emission.  The primary sample space [0, 1)^4 of
+// every light is split into RESOLUTION^4 cells, and each cell sums the
+// weights of the photons emitted from it that were gathered by visible hit
+// points.  Later passes emit from the cells in proportion to these sums,
+// mixed with a uniform share so that every cell keeps being sampled.  A
+// photon stands for 1 / density photons of uniform emission, which goes
+// into its power and weight like the light shares of ppmEmit.
+class EmissionGuide {
+public:
+    static const int RESOLUTION = 4;
+    static const int CELLS = RESOLUTION * RESOLUTION * RESOLUTION * RESOLUTION;
+    // Lights beyond this are emitted uniformly, their cells would not fit
+    // in Photon::cell.
+    static const int MAX_LIGHTS = NO_EMISSION_CELL / CELLS;
+
+    EmissionGuide();
+
+    // Forget the counts of the previous scene; emission is uniform again.
+    void reset(int lightNum);
+
+    // Generate a photon ray of light li, its cell and its weight, the
+    // inverse density.
+    std::pair<Ray, Vector3f> generate(const Light *light, int li, unsigned short &cell, float &weight) const;
+
+    // Add the gathered photon weights of every cell, indexed by cell.
+    void record(const std::vector<float> &counts);
+
+    // Rebuild the emission densities from the counts so far.
+    void update();
+
+    int getCellNum() const {
+        return (int) counts.size();
+    }
+
+private:
+    std::vector<float> counts;
+    std::vector<float> cdf;     // per light, CELLS entries ending in 1
+};
+
+#endif // EMISSION_GUIDE_H
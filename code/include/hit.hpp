@@ -1,10 +1,19 @@
 #ifndef HIT_H
 #define HIT_H
 
+#include <cstdio>
+#include <cstdlib>
 #include <vecmath.h>
 #include "ray.hpp"
 
 class Material;
+class Object3D;
+class Transform;
+
+// Hits are recorded in two phases.  During traversal an object only
+// records t, itself and what it needs to find the normal again (primitive
+// id, surface parameters u, v).  finalize then computes the normal and
+// material once, for the closest hit.
 
 class Hit {
 public:
@@ -13,19 +22,23 @@ public:
     Hit() {
         material = nullptr;
         t = 1e38;
+        object = nullptr;
+        primId = 0;
+        u = v = 0;
+        transformNum = 0;
     }
 
     Hit(float _t, Material *m, const Vector3f &n) {
         t = _t;
         material = m;
         normal = n;
+        object = nullptr;
+        primId = 0;
+        u = v = 0;
+        transformNum = 0;
     }
 
-    Hit(const Hit &h) {
-        t = h.t;
-        material = h.material;
-        normal = h.normal;
-    }
+    Hit(const Hit &h) = default;
 
     // destructor
     ~Hit() = default;
@@ -42,16 +55,73 @@ public:
         return normal;
     }
 
+    const Object3D *getObject() const {
+        return object;
+    }
+
+    int getPrimId() const {
+        return primId;
+    }
+
+    float getU() const {
+        return u;
+    }
+
+    float getV() const {
+        return v;
+    }
+
+    // Complete hit, nothing left for finalize but the transforms.
     void set(float _t, Material *m, const Vector3f &n) {
         t = _t;
         material = m;
         normal = n;
+        object = nullptr;
+        transformNum = 0;
     }
 
+    // Traversal phase: a closer hit on obj.
+    void record(float _t, const Object3D *obj, int _primId = 0, float _u = 0, float _v = 0) {
+        t = _t;
+        object = obj;
+        primId = _primId;
+        u = _u;
+        v = _v;
+        transformNum = 0;
+    }
+
+    // Used by Object3D::computeShading, n in object space.
+    void setShading(Material *m, const Vector3f &n) {
+        material = m;
+        normal = n;
+    }
+
+    // Deepest Transform nesting a hit can pass through, enforced by the parser
+    // for scene files and here for groups built in code
+    static const int MAX_TRANSFORMS = 8;
+
+    // Called by each Transform, innermost first, on the way out of a hit.
+    void pushTransform(const Transform *tr) {
+        if (transformNum == MAX_TRANSFORMS) {
+            printf("Transform nested deeper than %d levels\n", MAX_TRANSFORMS);
+            exit(1);
+        }
+        transforms[transformNum++] = tr;
+    }
+
+    // Compute the world space normal and material of the closest hit of
+    // world space ray r.  Call once the traversal is done.
+    void finalize(const Ray &r);
+
 private:
     float t;
     Material *material;
     Vector3f normal;
+    const Object3D *object;
+    int primId;
+    float u, v;
+    const Transform *transforms[MAX_TRANSFORMS];
+    int transformNum;
 
 };
 
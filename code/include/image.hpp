@@ -53,9 +53,14 @@ public:
 
     void SaveTGA(const char *filename) const;
 
-    int SaveBMP(const char *filename);
+    int SaveBMP(const char *filename) const;
 
-    void SaveImage(const char *filename);
+    // Full-precision outputs, written one scanline at a time.
+    int SavePFM(const char *filename) const;
+
+    int SaveEXR(const char *filename) const;
+
+    void SaveImage(const char *filename) const;
 
 private:
 
@@ -12,6 +12,14 @@
 
 class Mesh;
 
+// Pointer-free copy of a KDTree node, used to store a built tree on disk.
+struct KDTreeNode {
+    float box[2][3];
+    int dim;
+    int left, right;            // node indices, -1 if absent
+    int leafBegin, leafSize;    // range in the shared leaf triangle list
+};
+
 class KDTree {
 public:
 
@@ -29,6 +37,9 @@ public:
     void build(std::vector<int> &triId, int depth, int d);
     bool intersect(const Ray &r, Hit &h, float tmin);
     void getBox(std::vector<int> &triId);
+    // Append this subtree in pre-order and return the index of this node.
+    int flatten(std::vector<KDTreeNode> &nodes, std::vector<int> &leafIds) const;
+    void restore(const KDTreeNode *nodes, int index, const int *leafIds);
 
     Mesh *mesh;
     KDTree *left, *right;
@@ -1,10 +1,15 @@
 #ifndef LIGHT_H
 #define LIGHT_H
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <utility>
 #include <Vector3f.h>
 #include "object3d.hpp"
 #include "ray.hpp"
+#include "random.hpp"
 
 
 class Light {
@@ -15,7 +20,19 @@ public:
 
     virtual void getIllumination(const Vector3f &p, Vector3f &dir, Vector3f &col) const = 0;
 
-    virtual std::pair<Ray, Vector3f> generate() const = 0;
+    // Photon ray and color from the primary sample u in [0, 1)^4
+    virtual std::pair<Ray, Vector3f> generate(const float u[4]) const = 0;
+
+    virtual std::pair<Ray, Vector3f> generate() const {
+        float u[4];
+        for (int i = 0; i < 4; ++i)
+            u[i] = random01();
+        return generate(u);
+    }
+
+    // Relative emitted power, used to share the photons among lights.
+    // Zero for lights that cannot emit photons.
+    virtual Vector3f getPower() const = 0;
 
 };
 
@@ -40,11 +57,17 @@ public:
         col = color;
     }
 
-    virtual std::pair<Ray, Vector3f> generate() const override {
+    using Light::generate;
+
+    virtual std::pair<Ray, Vector3f> generate(const float u[4]) const override {
         printf("Cannot generate a ray from a directional light!");
         exit(0);
     }
 
+    Vector3f getPower() const override {
+        return Vector3f::ZERO;
+    }
+
 private:
 
     Vector3f direction;
@@ -71,14 +94,19 @@ public:
         col = color;
     }
 
-    virtual std::pair<Ray, Vector3f> generate() const override {
-        float x, y, z;
-        do {
-            x = 2.0 * rand() / RAND_MAX - 1;
-            y = 2.0 * rand() / RAND_MAX - 1;
-            z = 2.0 * rand() / RAND_MAX - 1;
-        } while (x * x + y * y + z * z <= 1);
-        return std::make_pair(Ray(position, Vector3f(x, y, z).normalized()), color);
+    using Light::generate;
+
+    // Uniform over the sphere.  Only u[0] and u[1] are used, so guide cells
+    // differing only in the last two digits cover the same directions.
+    virtual std::pair<Ray, Vector3f> generate(const float u[4]) const override {
+        float z = 1 - 2 * u[0];
+        float r = sqrt(std::max(0.0f, 1 - z * z));
+        float phi = 2 * acos(-1) * u[1];
+        return std::make_pair(Ray(position, Vector3f(r * cos(phi), r * sin(phi), z)), color);
+    }
+
+    Vector3f getPower() const override {
+        return color;
     }
 
 private:
@@ -124,24 +152,34 @@ public:
         col = color;
     }
 
-    virtual std::pair<Ray, Vector3f> generate() const override {
-        return std::make_pair(Ray(RandomOrigin(), RandomDirection()), color);
+    using Light::generate;
+
+    virtual std::pair<Ray, Vector3f> generate(const float u[4]) const override {
+        return std::make_pair(Ray(Origin(u[0], u[1]), Direction(u[2], u[3])), color);
+    }
+
+    Vector3f getPower() const override {
+        return color * (widthX * widthY);
     }
 
 private:
 
     Vector3f RandomOrigin() const {
-        float x = widthX * rand() / RAND_MAX - widthX / 2;
-        float y = widthY * rand() / RAND_MAX - widthY / 2;
+        return Origin(random01(), random01());
+    }
+
+    Vector3f Origin(float u, float v) const {
+        float x = widthX * u - widthX / 2;
+        float y = widthY * v - widthY / 2;
         return x * axisX + y * axisY + center;
     }
 
-    Vector3f RandomDirection() const {
+    Vector3f Direction(float u, float v) const {
         // p(theta) = sin(2 * theta)
         // t = - cos(2 * theta)  ->  p(t) = 0.5, -1 <= t <= 1
-        float t = 2.0 * rand() / RAND_MAX - 1;
+        float t = 2.0 * u - 1;
         float theta = -acos(t) / 2;
-        float phi = 2 * acos(-1) * rand() / RAND_MAX;
+        float phi = 2 * acos(-1) * v;
         float x = sin(theta) * cos(phi);
         float y = sin(theta) * sin(phi);
         float z = cos(theta);
@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.  The contents are not
+// null-terminated; always use data() together with size().
+class MappedFile {
+public:
+
+    explicit MappedFile(const char *filename);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const {
+        return opened;
+    }
+
+    const char *data() const {
+        return begin;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+
+    const char *begin;
+    size_t length;
+    bool opened;
+};
+
+#endif // MAPPED_FILE_H
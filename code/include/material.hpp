@@ -1,20 +1,89 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+#include <algorithm>
 #include <cassert>
 #include <vecmath.h>
 
 #include "ray.hpp"
 #include "hit.hpp"
+#include "photon.hpp"
+#include <cmath>
 #include <iostream>
 
+// Shading kernel, picked once per material from its constants.
+enum ShadeKernel {
+    SHADE_DIFFUSE,      // no specular term
+    SHADE_PHONG_INT,    // integer shininess, power by squaring
+    SHADE_PHONG         // general shininess, pow
+};
+
+const int MAX_INT_SHININESS = 1024;
+
+inline float powInt(float x, int n) {
+    float result = 1;
+    for (; n > 0; n >>= 1, x *= x)
+        if (n & 1)
+            result *= x;
+    return result;
+}
+
+// The photon-independent part of Shade at one hit point, with the material
+// colors premultiplied by the path throughput.  The specular dot product of
+// Shade is dot(rayLight, 2 (n.V) n - V), so only the mirrored view direction
+// is kept.
+struct ShadeState {
+    // Sum of throughput * Shade(rayView, p.dir, normal, p.power) over photons[0, count).
+    Vector3f gather(const Photon *photons, int count) const {
+        switch (kernel) {
+            case SHADE_DIFFUSE:
+                return gatherKernel<SHADE_DIFFUSE>(photons, count);
+            case SHADE_PHONG_INT:
+                return gatherKernel<SHADE_PHONG_INT>(photons, count);
+            default:
+                return gatherKernel<SHADE_PHONG>(photons, count);
+        }
+    }
+
+    template <ShadeKernel K>
+    Vector3f gatherKernel(const Photon *photons, int count) const {
+        int exponent = (int) shininess;
+        Vector3f diffuse = Vector3f::ZERO, specular = Vector3f::ZERO;
+        for (int i = 0; i < count; ++i) {
+            const Vector3f &dir = photons[i].dir;
+            diffuse += std::max(-Vector3f::dot(dir, normal), 0.0f) * photons[i].power;
+            if (K != SHADE_DIFFUSE) {
+                float dot_specular = Vector3f::dot(dir, mirrored);
+                if (dot_specular > 0)
+                    specular += (K == SHADE_PHONG_INT ? powInt(dot_specular, exponent) : std::pow(dot_specular, shininess))
+                              * photons[i].power;
+            }
+        }
+        if (K == SHADE_DIFFUSE)
+            return diffuseWeight * diffuse;
+        return diffuseWeight * diffuse + specularWeight * specular;
+    }
+
+    Vector3f normal;
+    Vector3f mirrored;
+    Vector3f diffuseWeight;
+    Vector3f specularWeight;
+    float shininess;
+    ShadeKernel kernel;
+};
+
 class Material {
 public:
 
     explicit Material(const Vector3f &d_color, const Vector3f &s_color = Vector3f::ZERO,
                       float s = 0, float ratio = 0, float ref = 1) :
             diffuseColor(d_color), specularColor(s_color), shininess(s), specularRatio(ratio), refraction(ref) {
-
+        if (specularColor == Vector3f::ZERO)
+            kernel = SHADE_DIFFUSE;
+        else if (shininess >= 0 && shininess <= MAX_INT_SHININESS && shininess == (int) shininess)
+            kernel = SHADE_PHONG_INT;
+        else
+            kernel = SHADE_PHONG;
     }
 
     virtual ~Material() = default;
@@ -31,7 +100,7 @@ public:
         if (dot_diffuse > 0)
             shaded += diffuseColor * dot_diffuse * lightColor;
         if (dot_specular > 0)
-            shaded += specularColor * pow(dot_specular, shininess) * lightColor;
+            shaded += specularColor * specularFactor(dot_specular) * lightColor;
         return shaded;
     }
 
@@ -43,15 +112,51 @@ public:
         if (dot_diffuse > 0)
             shaded += diffuseColor * dot_diffuse * lightColor;
         if (dot_specular > 0)
-            shaded += specularColor * pow(dot_specular, shininess) * lightColor;
+            shaded += specularColor * specularFactor(dot_specular) * lightColor;
         return shaded;
     }
 
+    ShadeState prepareShade(const Vector3f &rayView, const Vector3f &normal, const Vector3f &throughput) const {
+        ShadeState state;
+        state.normal = normal;
+        state.mirrored = 2 * Vector3f::dot(normal, rayView) * normal - rayView;
+        state.diffuseWeight = diffuseColor * throughput;
+        state.specularWeight = specularColor * throughput;
+        state.shininess = shininess;
+        state.kernel = kernel;
+        return state;
+    }
+
+    // Sum of Shade(rayView, p.dir, normal, p.power) over photons[0, count).
+    Vector3f ShadeBatch(const Vector3f &rayView, const Vector3f &normal, const Photon *photons, int count) const {
+        return prepareShade(rayView, normal, Vector3f(1)).gather(photons, count);
+    }
+
+    // Shade is zero everywhere
+    bool isBlack() const {
+        return diffuseColor == Vector3f::ZERO && specularColor == Vector3f::ZERO;
+    }
+
+    ShadeKernel getKernel() const {
+        return kernel;
+    }
+
     Vector3f diffuseColor;
     Vector3f specularColor;
     float shininess;
     float specularRatio;
     float refraction;
+
+private:
+    float specularFactor(float dot_specular) const {
+        if (kernel == SHADE_DIFFUSE)
+            return 0;
+        if (kernel == SHADE_PHONG_INT)
+            return powInt(dot_specular, (int) shininess);
+        return pow(dot_specular, shininess);
+    }
+
+    ShadeKernel kernel;
 };
 
 
@@ -6,6 +6,7 @@
 #include "triangle.hpp"
 #include "Vector3f.h"
 #include "kdtree.hpp"
+#include "profiler.hpp"
 
 class KDTree;
 
@@ -13,11 +14,13 @@ class Mesh : public Object3D {
 
 public:
     Mesh(Material *m) : Object3D(m) {
-
+        root = nullptr;
     }
     
     Mesh(const char *filename, Material *m);
 
+    ~Mesh() override;
+
     struct TriangleIndex {
         TriangleIndex() {
             x[0] = 0; x[1] = 0; x[2] = 0;
@@ -33,10 +36,73 @@ public:
     
     std::vector<Vector3f> v;
     std::vector<TriangleIndex> t;
+    // Texture coordinates and normals from vt / vn lines.  tt and tn hold
+    // the per-corner indices into them (-1 if a corner has none) and are
+    // left empty when no face references any.
+    std::vector<Vector2f> vt;
+    std::vector<Vector3f> vn;
+    std::vector<TriangleIndex> tt, tn;
+
+    // Per-triangle data for the intersection test, filled by buildTriangles
+    struct TriangleData {
+        Vector3f v0, e1, e2;
+        Vector3f normal;
+    };
+    std::vector<TriangleData> tri;
+
     KDTree *root;
     bool intersect(const Ray &r, Hit &h, float tmin) override;
+    void buildTriangles();
+    // Also builds the triangle data.
     void buildKDTree();
 
+    bool intersectTriangle(int triId, const Ray &r, Hit &h, float tmin) {
+        PJ_COUNT(COUNTER_TRIANGLE_TESTS);
+        const TriangleData &d = tri[triId];
+        float time, u, w;
+#ifdef PJ_WATERTIGHT
+        const TriangleIndex &index = t[triId];
+        if (!intersectTriangleWatertight(v[index.x[0]], v[index.x[1]], v[index.x[2]], r, time, u, w)) {
+            return false;
+        }
+#else
+        if (!::intersectTriangle(d.v0, d.e1, d.e2, r, time, u, w)) {
+            return false;
+        }
+#endif
+        if (time > tmin && time < h.getT()) {
+            h.record(time, this, triId, u, w);
+            return true;
+        }
+        return false;
+    }
+
+    void computeShading(const Ray &r, Hit &h) const override {
+        h.setShading(material, tri[h.getPrimId()].normal);
+    }
+
+};
+
+// A Mesh placed in the scene with its own material.  Instances of one
+// mesh, usually under different Transforms, share its triangles and KDTree.
+class MeshInstance : public Object3D {
+
+public:
+    MeshInstance(Mesh *mesh, Material *m) : Object3D(m), mesh(mesh) {}
+
+    bool intersect(const Ray &r, Hit &h, float tmin) override {
+        if (!mesh->intersect(r, h, tmin)) {
+            return false;
+        }
+        h.record(h.getT(), this, h.getPrimId(), h.getU(), h.getV());
+        return true;
+    }
+
+    void computeShading(const Ray &r, Hit &h) const override {
+        h.setShading(material, mesh->tri[h.getPrimId()].normal);
+    }
+
+    Mesh *mesh;
 };
 
 #endif
@@ -0,0 +1,22 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Mesh;
+
+// Binary cache of a parsed OBJ file and its KDTree, stored next to the
+// OBJ as "<obj file>.pjcache".  A cache is only used if its format
+// version and the hash of the OBJ contents both match.
+
+uint64_t hashMeshSource(const char *data, size_t size);
+
+// Fill an empty mesh (geometry and KDTree) from the cache of objFile.
+// Returns false if there is no valid cache.
+bool loadMeshCache(const char *objFile, uint64_t sourceHash, Mesh *mesh);
+
+// Write the cache of objFile; failures only disable caching.
+bool saveMeshCache(const char *objFile, uint64_t sourceHash, const Mesh *mesh);
+
+#endif // MESH_CACHE_H
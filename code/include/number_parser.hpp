@@ -0,0 +1,137 @@
+#ifndef NUMBER_PARSER_H
+#define NUMBER_PARSER_H
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Number parsing over raw character ranges that are not null-terminated
+// (e.g. a MappedFile).  Each parser skips leading blanks, advances p past
+// the number on success, and leaves p untouched on failure.
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Values that do not fit in an int fail.
+inline bool parseInt(const char *&p, const char *end, int &out) {
+    const char *q = skipBlanks(p, end);
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = *q == '-';
+        ++q;
+    }
+    if (q == end || !isDigit(*q)) {
+        return false;
+    }
+    const long long limit = negative ? -(long long) INT_MIN : INT_MAX;
+    long long value = 0;
+    while (q < end && isDigit(*q)) {
+        value = value * 10 + (*q - '0');
+        if (value > limit) {
+            return false;
+        }
+        ++q;
+    }
+    out = (int) (negative ? -value : value);
+    p = q;
+    return true;
+}
+
+inline bool parseFloat(const char *&p, const char *end, float &out) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *q = skipBlanks(p, end);
+    const char *start = q;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = *q == '-';
+        ++q;
+    }
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; q < end && isDigit(*q); ++q, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*q - '0');
+            digits += mantissa > 0;
+        }
+        else {
+            ++exponent;
+        }
+    }
+    if (q < end && *q == '.') {
+        for (++q; q < end && isDigit(*q); ++q, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*q - '0');
+                digits += mantissa > 0;
+                --exponent;
+            }
+        }
+    }
+    if (!any) {
+        // inf / nan and other rare spellings go through strtod
+        char buffer[64];
+        size_t n = 0;
+        while (start + n < end && n + 1 < sizeof(buffer) && !isBlank(start[n]) && start[n] != '\n') {
+            buffer[n] = start[n];
+            ++n;
+        }
+        buffer[n] = '\0';
+        char *stop;
+        double value = strtod(buffer, &stop);
+        if (stop == buffer) {
+            return false;
+        }
+        out = (float) value;
+        p = start + (stop - buffer);
+        return true;
+    }
+    if (q + 1 < end && (*q == 'e' || *q == 'E')) {
+        const char *e = q + 1;
+        bool expNegative = false;
+        if (*e == '-' || *e == '+') {
+            expNegative = *e == '-';
+            ++e;
+        }
+        if (e < end && isDigit(*e)) {
+            int value = 0;
+            for (; e < end && isDigit(*e); ++e) {
+                if (value < 10000) {
+                    value = value * 10 + (*e - '0');
+                }
+            }
+            exponent += expNegative ? -value : value;
+            q = e;
+        }
+    }
+    double value = (double) mantissa;
+    if (exponent >= 0 && exponent <= 22) {
+        value *= pow10[exponent];
+    }
+    else if (exponent < 0 && exponent >= -22) {
+        value /= pow10[-exponent];
+    }
+    else if (mantissa != 0) {
+        value *= std::pow(10.0, exponent);
+    }
+    out = (float) (negative ? -value : value);
+    p = q;
+    return true;
+}
+
+#endif // NUMBER_PARSER_H
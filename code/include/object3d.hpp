@@ -25,6 +25,10 @@ public:
     // Intersect Ray with this object. If hit, store information in hit structure.
     virtual bool intersect(const Ray &r, Hit &h, float tmin) = 0;
 
+    // Set the normal and material of a hit this object recorded, r being
+    // the ray in object space.
+    virtual void computeShading(const Ray &r, Hit &h) const {}
+
     Material *material;
     
 protected:
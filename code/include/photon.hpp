@@ -1,12 +1,171 @@
 #ifndef PHOTON_H
 #define PHOTON_H
 
+#include <algorithm>
+#include <cmath>
 #include <vecmath.h>
 
+// Emission cell of photons not emitted through an EmissionGuide
+const unsigned short NO_EMISSION_CELL = 0xFFFF;
+
 struct Photon {
     Vector3f pos;
     Vector3f dir;
     Vector3f power;
+    Vector3f normal;    // surface normal where stored, zero if none
+    float weight;       // number of photons of plain emission this one stands for
+    unsigned short cell;    // EmissionGuide cell the photon was emitted from
+};
+
+// Photon as kept in the photon map, 24 bytes instead of 56: the direction
+// is octahedral-encoded in 2 x 10 bits, the normal, only used to filter,
+// in 2 x 6 bits, the power is RGBE and the weight a 16-bit float.
+const int PHOTON_DIR_BITS = 10;
+const int PHOTON_NORMAL_BITS = 6;
+
+struct CompactPhoton {
+    Vector3f pos;
+    unsigned int dirNormal;     // direction in the low 20 bits, normal above
+    unsigned char power[4];
+    unsigned short weight;
+    unsigned short cell;
 };
 
+static_assert(sizeof(CompactPhoton) == 24, "CompactPhoton must stay 24 bytes");
+
+// Photons are gathered only by hit points whose normal is within this
+// cosine of theirs.
+const float PHOTON_NORMAL_COS = 0.7;
+
+// Octahedral encoding of a unit vector in two codes of the given number of
+// bits, each in 1..2^bits - 1; code 0 is left for the zero vector.
+inline unsigned int encodeOctahedral(const Vector3f &d, int bits) {
+    const float steps = (1 << bits) - 2;
+    float norm = std::abs(d[0]) + std::abs(d[1]) + std::abs(d[2]);
+    if (norm == 0) {
+        return 0;
+    }
+    // Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half.
+    float x = d[0] / norm, y = d[1] / norm;
+    if (d[2] < 0) {
+        float fx = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+        float fy = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = fx;
+        y = fy;
+    }
+    unsigned int cx = 1 + std::lround((x * 0.5f + 0.5f) * steps);
+    unsigned int cy = 1 + std::lround((y * 0.5f + 0.5f) * steps);
+    return cx | cy << bits;
+}
+
+inline Vector3f decodeOctahedral(unsigned int code, int bits) {
+    const unsigned int mask = (1u << bits) - 1;
+    if ((code & mask) == 0) {
+        return Vector3f::ZERO;
+    }
+    const float steps = (1 << bits) - 2;
+    float x = ((code & mask) - 1) / steps * 2 - 1, y = ((code >> bits & mask) - 1) / steps * 2 - 1;
+    float z = 1 - std::abs(x) - std::abs(y);
+    if (z < 0) {
+        float fx = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+        float fy = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = fx;
+        y = fy;
+    }
+    return Vector3f(x, y, z).normalized();
+}
+
+// Photon weights are positive: a 6-bit exponent and a 10-bit mantissa with
+// an implicit leading one, rounded to nearest, keep 2^-32..2^31 to 0.05%.
+// Code 0 is zero.
+const int WEIGHT_BIAS = 32;
+
+inline unsigned short encodeWeight(float w) {
+    if (!(w > 0)) {
+        return 0;
+    }
+    int e;
+    long mantissa = std::lround((std::frexp(w, &e) * 2 - 1) * 1024);
+    if (mantissa == 1024) {
+        mantissa = 0;
+        ++e;
+    }
+    e += WEIGHT_BIAS;
+    if (e < 1) {
+        return 0;
+    }
+    if (e > 63) {
+        return 0xFFFF;
+    }
+    return (unsigned short) (e << 10 | mantissa);
+}
+
+inline float decodeWeight(unsigned short code) {
+    if (code == 0) {
+        return 0;
+    }
+    return std::ldexp(1 + (code & 1023) / 1024.0f, (code >> 10) - WEIGHT_BIAS - 1);
+}
+
+#ifdef PJ_FULL_PRECISION_PHOTONS
+typedef Photon StoredPhoton;
+#else
+typedef CompactPhoton StoredPhoton;
+#endif
+
+inline void encodePhoton(const Photon &p, Photon &stored) {
+    stored = p;
+}
+
+inline Photon decodePhoton(const Photon &stored) {
+    return stored;
+}
+
+// Normal of a stored photon, without decoding the rest.
+inline Vector3f photonNormal(const Photon &stored) {
+    return stored.normal;
+}
+
+inline Vector3f photonNormal(const CompactPhoton &stored) {
+    return decodeOctahedral(stored.dirNormal >> 2 * PHOTON_DIR_BITS, PHOTON_NORMAL_BITS);
+}
+
+inline void encodePhoton(const Photon &p, CompactPhoton &stored) {
+    stored.pos = p.pos;
+    stored.dirNormal = encodeOctahedral(p.dir, PHOTON_DIR_BITS)
+                     | encodeOctahedral(p.normal, PHOTON_NORMAL_BITS) << 2 * PHOTON_DIR_BITS;
+    stored.weight = encodeWeight(p.weight);
+    stored.cell = p.cell;
+
+    float m = std::max(p.power[0], std::max(p.power[1], p.power[2]));
+    if (m < 1e-32f) {
+        stored.power[0] = stored.power[1] = stored.power[2] = stored.power[3] = 0;
+    }
+    else {
+        int e;
+        float scale = std::frexp(m, &e) * 256 / m;
+        for (int c = 0; c < 3; ++c)
+            stored.power[c] = (unsigned char) std::min(std::max(p.power[c] * scale, 0.0f), 255.0f);
+        stored.power[3] = (unsigned char) (e + 128);
+    }
+}
+
+inline Photon decodePhoton(const CompactPhoton &stored) {
+    Photon p;
+    p.pos = stored.pos;
+    p.dir = decodeOctahedral(stored.dirNormal, PHOTON_DIR_BITS);
+    p.normal = photonNormal(stored);
+    p.weight = decodeWeight(stored.weight);
+    p.cell = stored.cell;
+
+    if (stored.power[3] == 0) {
+        p.power = Vector3f::ZERO;
+    }
+    else {
+        float f = std::ldexp(1.0f, stored.power[3] - (128 + 8));
+        p.power = Vector3f((stored.power[0] + 0.5f) * f, (stored.power[1] + 0.5f) * f, (stored.power[2] + 0.5f) * f);
+    }
+    return p;
+}
+
 #endif // PHOTON_H
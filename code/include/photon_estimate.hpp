@@ -0,0 +1,43 @@
+#ifndef PHOTON_ESTIMATE_H
+#define PHOTON_ESTIMATE_H
+
+#include <cmath>
+#include <vecmath.h>
+
+// Progressive radiance estimate of one photon map at one hit point.
+struct PhotonEstimate {
+    PhotonEstimate(float num = 0, float alpha = 0, float radius = 0) : power(Vector3f::ZERO), num(num), alpha(alpha), radius(radius) {
+
+    }
+
+    // Zero until a photon has been gathered.
+    Vector3f radiance() const {
+        if (num <= 0) {
+            return Vector3f::ZERO;
+        }
+        return power / (acos(-1.0) * radius * radius * num);
+    }
+
+    // Adds the shaded power of m newly gathered photons, keeping a
+    // fraction alpha of them and shrinking the radius to match.  m may be
+    // fractional when photons are weighted.
+    void update(const Vector3f &addPower, float m) {
+        float n_prime = num + alpha * m;
+        float r_prime = radius;
+        Vector3f power_prime = power + addPower;
+        if (num + m > 0) {
+            r_prime *= sqrt(n_prime / (num + m));
+            power_prime *= n_prime / (num + m);
+        }
+        num = n_prime;
+        radius = r_prime;
+        power = power_prime;
+    }
+
+    Vector3f power;
+    float num;
+    float alpha;
+    float radius;
+};
+
+#endif // PHOTON_ESTIMATE_H
@@ -0,0 +1,50 @@
+#ifndef PHOTON_KDTREE_H
+#define PHOTON_KDTREE_H
+
+#include <vector>
+#include <vecmath.h>
+#include "photon.hpp"
+
+// Balanced kd-tree over the photons of one pass, shared by PPM and SPPM.
+// The tree is implicit: the node of the range [begin, end) is the median
+// at begin + (end - begin) / 2, split on the axis cycling with depth.
+class PhotonKDTree {
+public:
+    PhotonKDTree();
+
+    ~PhotonKDTree();
+
+    // Reorders [begin, end) into the tree layout and stores it.
+    void build(std::vector<Photon>::iterator begin, std::vector<Photon>::iterator end, int splitDim);
+
+    // Append every photon within distance r of p to data.  With a nonzero
+    // normal, photons whose normal differs from it by more than
+    // PHOTON_NORMAL_COS are skipped; photons without a normal always match.
+    // traceRay turns normals towards the hit side, so this also skips
+    // photons on the far side of thin geometry.
+    void collect(Vector3f p, float r, std::vector<Photon> &data, const Vector3f &normal = Vector3f::ZERO);
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+private:
+
+    struct cmpPhoton {
+        cmpPhoton(int _d) {d = _d;}
+        bool operator() (const Photon &a, const Photon &b) {
+            return a.pos[d] < b.pos[d];
+        }
+        int d;
+    };
+
+    void split(std::vector<Photon>::iterator begin, std::vector<Photon>::iterator end, int splitDim);
+
+    void collect(const Vector3f &p, float r2, const Vector3f &normal, int begin, int end, int splitDim,
+                 std::vector<Photon> &data) const;
+
+    std::vector<StoredPhoton> nodes;
+    int rootDim;
+};
+
+#endif // PHOTON_KDTREE_H
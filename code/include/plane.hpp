@@ -27,11 +27,15 @@ public:
             return false;
         float t = (d - Vector3f::dot(normal, r.getOrigin())) / c;
         if (t > tmin && t < h.getT()) {
-            h.set(t, material, normal);
+            h.record(t, this);
             return true;
         }
         return false;
     }
+
+    void computeShading(const Ray &r, Hit &h) const override {
+        h.setShading(material, normal);
+    }
     
     Vector3f normal;
     float d;
@@ -3,187 +3,67 @@
 
 #include <cmath>
 #include <vector>
-#include <algorithm>
 #include <vecmath.h>
 #include "camera.hpp"
+#include "emission_guide.hpp"
 #include "light.hpp"
 #include "photon.hpp"
+#include "photon_estimate.hpp"
+#include "photon_kdtree.hpp"
 #include "tracer.hpp"
 
-const float ALPHA = 0.7;
-const float RADIUS = 0.3;
+const float PPM_ALPHA = 0.7;
+const float PPM_RADIUS = 0.3;
+
+// Photons kept by one emission
+enum PhotonMapType {
+    MAP_ALL,        // every photon in one map
+    MAP_GLOBAL,     // all but caustic photons
+    MAP_CAUSTIC     // photons that only hit specular surfaces before, traced to the first diffuse hit
+};
 
 struct viewPoint {
-    Vector3f radiance() {
-        return power / (acos(-1.0) * radius * radius * num);
+    Vector3f radiance() const {
+        return estimate.radiance();
     }
     Trace trace;
-    Vector3f power;
-    float num;
-    float alpha;
-    float radius;
+    ShadeState shade;
+    PhotonEstimate estimate;    // of the global and caustic maps together
 };
 
-class PhotonKDTree {
-public:
-    PhotonKDTree() {
-        left = nullptr;
-        right = nullptr;
-        box[0] = Vector3f(1e38);
-        box[1] = Vector3f(-1e38);
-    }
-    
-    ~PhotonKDTree() {
-        delete left;
-        delete right;
-    }
-
-    void build(std::vector<Photon>::iterator begin, std::vector<Photon>::iterator end, int splitDim) {
-        int length = end - begin;
-        int mid = length / 2;
-        cmpPhoton func(splitDim);
-        std::nth_element(begin, begin + mid, end, func);
-        photon = *(begin + mid);
-        box[0] = box[1] = photon.pos;
-        if (mid > 0) {
-            left = new PhotonKDTree;
-            left->build(begin, begin + mid, (splitDim + 1) % 3);
-            for (int dim = 0; dim < 3; ++dim) {
-                box[0][dim] = std::min(box[0][dim], left->box[0][dim]);
-                box[1][dim] = std::max(box[1][dim], left->box[1][dim]);
-            }
-        }
-        if (mid < length - 1) {
-            right = new PhotonKDTree;
-            right->build(begin + mid + 1, end, (splitDim + 1) % 3);
-            for (int dim = 0; dim < 3; ++dim) {
-                box[0][dim] = std::min(box[0][dim], right->box[0][dim]);
-                box[1][dim] = std::max(box[1][dim], right->box[1][dim]);
-            }
-        }
-    }
-
-    void collect(Vector3f p, float r, std::vector<Photon> &data) {
-        float dis = 0;
-        for (int dim = 0; dim < 3; ++dim) {
-            if (p[dim] < box[0][dim]) {
-                dis += (box[0][dim] - p[dim]) * (box[0][dim] - p[dim]);
-            }
-            else if(p[dim] > box[1][dim]) {
-                dis += (p[dim] - box[1][dim]) * (p[dim] - box[1][dim]);
-            }
-        }
-        if (dis <= r * r) {
-            if ((p - photon.pos).squaredLength() <= r * r) {
-                data.emplace_back(photon);
-            }
-            if (left != nullptr) {
-                left->collect(p, r, data);
-            }
-            if (right != nullptr) {
-                right->collect(p, r, data);
-            }
-        }
-    }
+// Trace spp camera paths per pixel and record their diffuse hits as view points.
+void ppmBackward(Object3D *o, Camera *camera, int spp, std::vector<std::vector<viewPoint>> &imgView);
 
-private:
+// Shares lights.size() * rayNum photons among the lights in proportion to
+// their power, by largest remainder.  Every light with power gets at
+// least one.
+std::vector<int> lightPhotonCounts(const std::vector<Light*> &lights, int rayNum);
 
-    struct cmpPhoton {
-        cmpPhoton(int _d) {d = _d;}
-        bool operator() (Photon a, Photon b) {
-            return a.pos[d] < b.pos[d];
-        }
-        int d;
-    };
+// Trace lights.size() * rayNum photons, shared by lightPhotonCounts, up to
+// depth bounces, keeping the photons of the given map.  A photon of a
+// light that got n photons stands for rayNum / n photons of rayNum per
+// light, and carries that weight in power and in Photon::weight, since
+// estimates divide by the photons gathered.  Non-caustic photons are
+// emitted through the guide if there is one, which multiplies in its own
+// weight.  Also used by SPPM.
+void ppmEmit(Object3D *o, std::vector<Light*> lights, int rayNum, std::vector<Photon> &photons, int depth = 5,
+             PhotonMapType type = MAP_ALL, const EmissionGuide *guide = nullptr);
 
-    PhotonKDTree *left, *right;
-    Vector3f box[2];
-    Photon photon;
-};
+// Progressive update of the estimate of every view point from root and,
+// unless it is null, causticRoot.  The number of photons gathered is the
+// sum of their weights.  Caustic photons count causticWeight times more,
+// in power and number, for the photons of a single map they stand for.
+// The gathered weights are added to the guide if there is one.
+void ppmGather(PhotonKDTree *root, std::vector<std::vector<viewPoint>> &imgView,
+               PhotonKDTree *causticRoot = nullptr, float causticWeight = 1, EmissionGuide *guide = nullptr);
 
-void ppmBackward(Object3D *o, Camera *camera, int spp, std::vector<std::vector<viewPoint>> &imgView) {
-    for (int x = 0; x < camera->getWidth(); ++x) {
-        std::cout << "Line " << x << std::endl;
-        #pragma omp parallel for schedule(dynamic, 128), num_threads(8)
-        for (int y = 0; y < camera->getHeight(); ++y) {
-            std::vector<Trace> trace;
-            std::vector<viewPoint> view;
-            for (int sppId = 0; sppId < spp; ++sppId) {
-                Ray r = camera->generateRay(Vector2f(x, y));
-                traceRay(o, r, Vector3f(1.0 / spp), 5, trace, false);
-            }
-            for (Trace &t: trace) {
-                viewPoint point;
-                point.trace = t;
-                point.power = Vector3f::ZERO;
-                point.num = 0;
-                point.alpha = ALPHA;
-                point.radius = RADIUS;
-                view.push_back(point);
-            }
-            imgView.push_back(view);
-        }
-    }
-}
+// One photon pass: emit, build the photon maps and gather into the view
+// points of every camera.  With causticNum > 0, caustic photons get their
+// own map of causticNum photons per light and the rayNum photons per light
+// fill the global map; the estimate stays that of a single map.
+void ppmForward(Object3D *o, std::vector<Light*> lights, int rayNum, int causticNum,
+                std::vector<std::vector<std::vector<viewPoint>>> &views, EmissionGuide *guide = nullptr);
 
-void ppmForward(Object3D *o, std::vector<Light*> lights, int rayNum, std::vector<std::vector<viewPoint>> &imgView) {
-    std::vector<Photon> photons;
-    #pragma omp parallel for schedule(dynamic, 60), num_threads(8)
-    for (Light *&l: lights) {
-        for (int rayId = 0; rayId < rayNum; ++rayId) {
-            std::pair<Ray, Vector3f> generation = l->generate();
-            Ray r = generation.first;
-            Vector3f col = generation.second;
-            Photon origin;
-            origin.pos = r.getOrigin();
-            origin.dir = -r.getDirection();
-            origin.power = col * 10;
-            photons.push_back(origin);
-            std::vector<Trace> trace;
-            traceRay(o, r, col, 5, trace, true);
-            for (Trace &t: trace) {
-                photons.push_back(t.photon);
-            }
-        }
-    }
-    std::cout << photons.size() << " photons in total." << std::endl;
-    PhotonKDTree *root = new PhotonKDTree;
-    root->build(photons.begin(), photons.end(), 0);    
-    #pragma omp parallel for schedule(dynamic, 128), num_threads(8)
-    for (int viewId = 0; viewId < (int) imgView.size(); ++viewId) {
-        if (viewId % (imgView.size() / 100) == 0) {
-            std::cout << "View " << viewId << std::endl;
-        }
-        for (viewPoint &point: imgView[viewId]) {
-            std::vector<Photon> photon;
-            root->collect(point.trace.photon.pos, point.radius, photon);
-            int m = (int) photon.size();
-            Vector3f power = Vector3f::ZERO;
-            for (Photon &p: photon) {
-                power += point.trace.photon.power
-                       * point.trace.material->Shade(point.trace.photon.dir, p.dir, point.trace.normal, p.power);
-            }
-            float n_prime = point.num + point.alpha * m;
-            float r_prime = point.radius;
-            Vector3f power_prime = point.power + power;
-            if (point.num + m > 0) {
-                r_prime *= sqrt(n_prime / (point.num + m));
-                power_prime *= n_prime / (point.num + m);
-            }
-            point.num = n_prime;
-            point.radius = r_prime;
-            point.power = power_prime;
-        }
-    }
-    delete root;
-}
-
-Vector3f getRadiance(std::vector<viewPoint> view) {
-    Vector3f radiance = Vector3f::ZERO;
-    for (viewPoint &point: view) {
-        radiance += point.radiance();
-    }
-    return radiance;
-}
+Vector3f getRadiance(const std::vector<viewPoint> &view);
 
 #endif // PPM_H
@@ -0,0 +1,102 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Wall and CPU time spent in each phase of a render.  Phases are timed
+// with ScopedPhase on the thread that drives the render (the parallel
+// loops run inside a phase).  A phase nested in another one, such as the
+// KDTree build during scene parsing, is subtracted from the outer phase,
+// so every phase reports exclusive time.
+
+enum Phase {
+    PHASE_PARSE,
+    PHASE_ACCEL_BUILD,
+    PHASE_HIT_POINTS,
+    PHASE_PHOTON_EMIT,
+    PHASE_PHOTON_MAP,
+    PHASE_GATHER,
+    PHASE_RESOLVE,
+    PHASE_COUNT
+};
+
+struct PhaseTime {
+    double wall;
+    double cpu;     // process CPU time, summed over all threads
+    long long calls;
+};
+
+const char *phaseName(Phase phase);
+
+const PhaseTime &getPhaseTime(Phase phase);
+
+void resetPhaseTimes();
+
+double wallSeconds();
+
+double cpuSeconds();
+
+class ScopedPhase {
+public:
+    explicit ScopedPhase(Phase phase);
+
+    ~ScopedPhase();
+
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+private:
+    Phase phase;
+    ScopedPhase *parent;
+    double wallStart, cpuStart;
+    // time spent in nested phases
+    double childWall, childCpu;
+};
+
+// Hot-path event counters.  Each thread increments its own slot, the
+// slots are summed by getCounter.  Counting compiles to nothing unless
+// the build defines PJ_PROFILE (cmake -DPJ_PROFILE=ON).
+
+enum Counter {
+    COUNTER_RAYS,
+    COUNTER_BOX_TESTS,
+    COUNTER_TRIANGLE_TESTS,
+    COUNTER_PHOTONS_STORED,
+    COUNTER_PHOTONS_GATHERED,
+    COUNTER_NEWTON_ITERATIONS,
+    COUNTER_COUNT
+};
+
+const char *counterName(Counter counter);
+
+long long getCounter(Counter counter);
+
+// Not thread safe, call outside parallel regions.
+void resetCounters();
+
+// Counter slots of the calling thread.
+long long *registerCounterSlots();
+
+inline long long *threadCounters() {
+    static thread_local long long *slots = nullptr;
+    if (slots == nullptr) {
+        slots = registerCounterSlots();
+    }
+    return slots;
+}
+
+#ifdef PJ_PROFILE
+const bool COUNTERS_ENABLED = true;
+#define PJ_COUNT(counter) (++threadCounters()[counter])
+#define PJ_COUNT_ADD(counter, n) (threadCounters()[counter] += (n))
+#else
+const bool COUNTERS_ENABLED = false;
+#define PJ_COUNT(counter) ((void) 0)
+#define PJ_COUNT_ADD(counter, n) ((void) 0)
+#endif
+
+// Chrome trace-event output (chrome://tracing, Perfetto) of every
+// ScopedPhase while tracing is on.
+void startTrace();
+
+bool writeTrace(const char *filename);
+
+#endif // PROFILER_H
@@ -0,0 +1,15 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+// Per thread random numbers for sampling.  Every thread draws from its own
+// generator, seeded from the global seed and the OpenMP thread number, so
+// parallel loops do not contend on rand() and a seed gives the same
+// numbers to the same thread.
+
+// Reseeds the generators of all threads on their next draw.
+void seedRandom(unsigned int seed);
+
+// Uniform in [0, 1)
+float random01();
+
+#endif // RANDOM_H
@@ -21,6 +21,8 @@ public:
         direction = r.direction;
     }
 
+    Ray &operator=(const Ray &r) = default;
+
     const Vector3f &getOrigin() const {
         return origin;
     }
@@ -0,0 +1,86 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <vector>
+#include "image.hpp"
+#include "light.hpp"
+#include "ppm.hpp"
+#include "scene_parser.hpp"
+#include "sppm.hpp"
+
+enum RenderEngine {
+    ENGINE_PPM,     // camera hit points traced once, photons gathered every pass
+    ENGINE_SPPM     // camera paths retraced every pass
+};
+
+// "ppm" or "sppm"
+bool parseRenderEngine(const char *name, RenderEngine &engine);
+
+struct RenderSettings {
+    RenderEngine engine = ENGINE_PPM;
+    int spp = 8;                // camera samples per pixel
+    int photons = 200000;       // photons per light per pass
+    int causticPhotons = 0;     // per light per pass for a separate caustic map, 0 for one map
+    bool guided = false;        // steer photon emission towards the photons visible hit points gather
+};
+
+// Progressive render of one scene:
+//     renderer.loadScene(file);
+//     renderer.configure(settings);
+//     while (...) { renderer.renderPass(); use(renderer.getFramebuffer()); }
+// A scene with several cameras gets one framebuffer per camera, all
+// gathering from the same photons of each pass.
+class Renderer {
+public:
+    Renderer();
+
+    ~Renderer();
+
+    Renderer(const Renderer &) = delete;
+    Renderer &operator=(const Renderer &) = delete;
+
+    // Exits on a malformed scene like SceneParser does, or one without a
+    // camera.
+    void loadScene(const char *filename);
+
+    // Restarts the progressive estimate.
+    void configure(const RenderSettings &settings);
+
+    void renderPass();
+
+    // Radiance estimate of a camera after the passes so far.
+    const Image &getFramebuffer(int cameraId = 0);
+
+    int getNumCameras() const {
+        return (int) cameras.size();
+    }
+
+    const RenderSettings &getSettings() const {
+        return settings;
+    }
+
+    int getPassCount() const {
+        return passes;
+    }
+
+    SceneParser *getScene() const {
+        return scene;
+    }
+
+private:
+    void reset();
+
+    SceneParser *scene;
+    std::vector<Light *> lights;
+    std::vector<Camera *> cameras;
+    RenderSettings settings;
+    int passes;
+    // per camera
+    std::vector<std::vector<std::vector<viewPoint>>> ppmViews;
+    std::vector<std::vector<sppmPixel>> sppmViews;
+    std::vector<Image *> framebuffers;
+    std::vector<bool> resolved;
+    EmissionGuide guide;
+};
+
+#endif // RENDERER_H
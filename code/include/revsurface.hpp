@@ -3,17 +3,26 @@
 
 #include "object3d.hpp"
 #include "curve.hpp"
+#include "mesh.hpp"
+#include "profiler.hpp"
+#include <algorithm>
 #include <cmath>
 #include <tuple>
 
 const int N_ITER = 10;
+// Resolution of the Newton seed table over (radius, y), and the curve
+// samples searched for each of its nodes.
+const int SEED_GRID = 32;
+const int SEED_SAMPLES = 256;
+// Default bound on the distance between the proxy mesh and the surface
+const float REV_TOLERANCE = 0.01;
 
 class RevSurface : public Object3D {
 
     Curve *pCurve;
 
 public:
-    RevSurface(Curve *pCurve, Material* material) : pCurve(pCurve), Object3D(material) {
+    RevSurface(Curve *pCurve, Material* material, float tolerance = REV_TOLERANCE) : pCurve(pCurve), Object3D(material) {
         // Check flat.
         for (const auto &cp : pCurve->getControls()) {
             if (cp.z() != 0.0) {
@@ -22,17 +31,24 @@ public:
             }
         }
         mesh = new Mesh(material);
-        
-        pCurve->discretize(20, curvePoints);
+        buildBound();
 
-        const int steps = 30;
+        pCurve->discretizeAdaptive(tolerance, curvePoints);
+
+        // Fewest angular steps whose chords stay within tolerance of the
+        // widest circle; the rings are scaled to circumscribe their circles.
+        int steps = 8;
+        if (radiusMax > tolerance)
+            steps = std::max(steps, (int) std::ceil(3.14159 / std::acos(1 - tolerance / radiusMax)));
+        steps = std::min(steps, 1024);
+        float scale = 1 / cos(3.14159 / steps);
         for (int ci = 0; ci < (int) curvePoints.size(); ++ci) {
             const CurvePoint &cp = curvePoints[ci];
             for (int i = 0; i < steps; ++i) {
                 float t = (float) i / steps;
                 Quat4f rot;
                 rot.setAxisAngle(t * 2 * 3.14159, Vector3f::UP);
-                Vector3f pnew = (Matrix3f::rotation(rot) * cp.V) / cos(t * 3.14159);
+                Vector3f pnew = Matrix3f::rotation(rot) * Vector3f(cp.V[0] * scale, cp.V[1], 0);
                 mesh->v.push_back(pnew);
                 int i1 = (i + 1 == steps) ? 0 : i + 1;
                 if (ci != curvePoints.size() - 1) {
@@ -41,39 +57,32 @@ public:
                 }
             }
         }
-        std::cout << mesh->t.size() << std::endl;
         mesh->buildKDTree();
+        buildSeedTable();
     }
 
     ~RevSurface() override {
+        delete mesh;
         delete pCurve;
     }
 
     bool intersect(const Ray &r, Hit &h, float tmin) override {
+        if (!intersectBound(r, tmin, h.getT())) return false;
         Hit temp(h);
         bool its = mesh->intersect(r, temp, tmin);
         if (!its) return false;
         Vector3f p = r.pointAtParameter(temp.getT());
         float radius = sqrt(p[0] * p[0] + p[2] * p[2]);
 
-        float t_curve;
-        float min_dis = 1e38;
+        float t_curve = seedParameter(radius, p[1]);
         std::pair<float, float> range = pCurve->getRange();
 
-        for (int ci = 0; ci < (int) curvePoints.size(); ++ci) {
-            const CurvePoint &cp = curvePoints[ci];
-            float dis = (cp.V[0] - radius) * (cp.V[0] - radius) + cp.V[1] * cp.V[1];
-            if (dis < min_dis) {
-                min_dis = dis;
-                t_curve = (range.second - range.first) / (curvePoints.size() - 1) * ci;
-            }
-        }
-
         int iter = N_ITER;
         bool clamp_first = false, clamp_second = false;
         bool flag = false;
 
         while (iter--) {
+            PJ_COUNT(COUNTER_NEWTON_ITERATIONS);
             CurvePoint point = pCurve->getCurvePoint(t_curve);
             float t_ray, f, df;
             bool end_iter = false, t_flag = false;
@@ -119,13 +128,7 @@ public:
             if (end_iter) {
                 if (t_flag) {
                     flag = true;
-                    Vector3f dt = r.pointAtParameter(t_ray);
-                    Vector3f ds(-dt[2], 0, dt[0]);
-                    dt[0] *= point.T[0] / point.V[0];
-                    dt[1] = point.T[1];
-                    dt[2] *= point.T[0] / point.V[0];
-                    Vector3f normal = -Vector3f::cross(dt, ds).normalized();
-                    h.set(t_ray, material, normal);
+                    h.record(t_ray, this, 0, t_curve);
                 }
                 break;
             }
@@ -145,8 +148,99 @@ public:
         return flag;
     }
 
+    // u is the curve parameter of the hit
+    void computeShading(const Ray &r, Hit &h) const override {
+        CurvePoint point = pCurve->getCurvePoint(h.getU());
+        Vector3f dt = r.pointAtParameter(h.getT());
+        Vector3f ds(-dt[2], 0, dt[0]);
+        dt[0] *= point.T[0] / point.V[0];
+        dt[1] = point.T[1];
+        dt[2] *= point.T[0] / point.V[0];
+        h.setShading(material, -Vector3f::cross(dt, ds).normalized());
+    }
+
     std::vector<CurvePoint> curvePoints;
     Mesh *mesh;
+
+private:
+    // Both splines lie in the convex hull of their controls, so the
+    // cylinder |x| <= radiusMax, yMin <= y <= yMax bounds the surface.
+    void buildBound() {
+        radiusMax = 0;
+        yMin = 1e38;
+        yMax = -1e38;
+        for (const auto &cp : pCurve->getControls()) {
+            radiusMax = std::max(radiusMax, std::abs(cp.x()));
+            yMin = std::min(yMin, cp.y());
+            yMax = std::max(yMax, cp.y());
+        }
+    }
+
+    // Does r pass through the bounding cylinder between tmin and tmax?
+    bool intersectBound(const Ray &r, float tmin, float tmax) const {
+        const Vector3f &o = r.getOrigin(), &d = r.getDirection();
+        float t0 = tmin, t1 = tmax;
+        if (d[1] != 0) {
+            float ta = (yMin - o[1]) / d[1], tb = (yMax - o[1]) / d[1];
+            t0 = std::max(t0, std::min(ta, tb));
+            t1 = std::min(t1, std::max(ta, tb));
+        }
+        else if (o[1] < yMin || o[1] > yMax) {
+            return false;
+        }
+        float a = d[0] * d[0] + d[2] * d[2];
+        float b = o[0] * d[0] + o[2] * d[2];
+        float c = o[0] * o[0] + o[2] * o[2] - radiusMax * radiusMax;
+        if (a == 0) {
+            if (c > 0) return false;
+        }
+        else {
+            float delta = b * b - a * c;
+            if (delta < 0) return false;
+            delta = std::sqrt(delta);
+            t0 = std::max(t0, (-b - delta) / a);
+            t1 = std::min(t1, (-b + delta) / a);
+        }
+        return t0 <= t1;
+    }
+
+    // For every node of a SEED_GRID x SEED_GRID grid over the bound's
+    // (radius, y) section, the curve parameter of the nearest curve point.
+    void buildSeedTable() {
+        std::pair<float, float> range = pCurve->getRange();
+        std::vector<float> sampleT(SEED_SAMPLES);
+        std::vector<Vector2f> sampleP(SEED_SAMPLES);
+        for (int i = 0; i < SEED_SAMPLES; ++i) {
+            sampleT[i] = range.first + (range.second - range.first) * i / (SEED_SAMPLES - 1);
+            Vector3f V = pCurve->getCurvePoint(sampleT[i]).V;
+            sampleP[i] = Vector2f(std::abs(V[0]), V[1]);
+        }
+        seedTable.resize(SEED_GRID * SEED_GRID);
+        for (int iy = 0; iy < SEED_GRID; ++iy) {
+            for (int ir = 0; ir < SEED_GRID; ++ir) {
+                Vector2f node(radiusMax * ir / (SEED_GRID - 1), yMin + (yMax - yMin) * iy / (SEED_GRID - 1));
+                float min_dis = 1e38;
+                for (int i = 0; i < SEED_SAMPLES; ++i) {
+                    float dis = (sampleP[i] - node).absSquared();
+                    if (dis < min_dis) {
+                        min_dis = dis;
+                        seedTable[iy * SEED_GRID + ir] = sampleT[i];
+                    }
+                }
+            }
+        }
+    }
+
+    float seedParameter(float radius, float y) const {
+        float fr = radiusMax > 0 ? radius / radiusMax : 0;
+        float fy = yMax > yMin ? (y - yMin) / (yMax - yMin) : 0;
+        int ir = std::min(std::max((int) (fr * (SEED_GRID - 1) + 0.5f), 0), SEED_GRID - 1);
+        int iy = std::min(std::max((int) (fy * (SEED_GRID - 1) + 0.5f), 0), SEED_GRID - 1);
+        return seedTable[iy * SEED_GRID + ir];
+    }
+
+    float radiusMax, yMin, yMax;
+    std::vector<float> seedTable;
 };
 
 #endif //REVSURFACE_HPP
@@ -2,6 +2,9 @@
 #define SCENE_PARSER_H
 
 #include <cassert>
+#include <map>
+#include <string>
+#include <vector>
 #include <vecmath.h>
 
 class Camera;
@@ -18,6 +21,13 @@ class Curve;
 class RevSurface;
 
 #define MAX_PARSER_TOKEN_LENGTH 1024
+#define MAX_INCLUDE_DEPTH 32
+
+// Scene files are sequences of whitespace separated tokens.  A token
+// "#include <file>" (the file name optionally quoted) inserts the tokens
+// of another scene file, with relative paths resolved against the
+// directory of the including file.  Syntax errors report file, line and
+// column and terminate the program.
 
 class SceneParser {
 public:
@@ -27,8 +37,19 @@ public:
 
     ~SceneParser();
 
+    // The first camera, nullptr if there is none.
     Camera *getCamera() const {
-        return camera;
+        return cameras.empty() ? nullptr : cameras[0];
+    }
+
+    // Every camera block of the scene adds a view.
+    int getNumCameras() const {
+        return (int) cameras.size();
+    }
+
+    Camera *getCamera(int i) const {
+        assert(i >= 0 && i < (int) cameras.size());
+        return cameras[i];
     }
 
     Vector3f getBackgroundColor() const {
@@ -74,27 +95,47 @@ private:
     Sphere *parseSphere();
     Plane *parsePlane();
     Triangle *parseTriangle();
-    Mesh *parseTriangleMesh();
+    Object3D *parseTriangleMesh();
     Transform *parseTransform();
     Curve *parseBezierCurve();
     Curve *parseBsplineCurve();
     RevSurface *parseRevSurface();
 
+    struct SceneSource;
+
+    bool pushSource(const char *filename);
+    int readToken(char token[MAX_PARSER_TOKEN_LENGTH]);
+    // Returns 0 at the end of the top-level file.
     int getToken(char token[MAX_PARSER_TOKEN_LENGTH]);
+    // Like getToken, but the end of file is an error.
+    void nextToken(char token[MAX_PARSER_TOKEN_LENGTH]);
+    void expectToken(const char *expected);
+    // A path relative to the file of the last token, unless absolute.
+    std::string resolvePath(const std::string &name) const;
+    void requireMaterial();
+    [[noreturn]] void parseError(const char *format, ...);
 
     Vector3f readVector3f();
 
     float readFloat();
     int readInt();
-
-    FILE *file;
-    Camera *camera;
+    // An integer of at least 0, for the numLights / numMaterials / numObjects counts.
+    int readCount();
+
+    std::vector<SceneSource *> sources;
+    // position of the last token read, for error messages
+    std::string tokenFile;
+    int tokenLine, tokenColumn;
+    std::vector<Camera *> cameras;
     Vector3f background_color;
     int num_lights;
     Light **lights;
     int num_materials;
     Material **materials;
     Material *current_material;
+    int transformDepth;
+    // every .obj file is loaded once and shared by its instances
+    std::map<std::string, Mesh *> meshes;
     Group *group;
 };
 
@@ -35,12 +35,16 @@ public:
         else
             return false;
         if (t < h.getT()) {
-            h.set(t, material, (r.pointAtParameter(t) - center).normalized());
+            h.record(t, this);
             return true;
         }
         return false;
     }
 
+    void computeShading(const Ray &r, Hit &h) const override {
+        h.setShading(material, (r.pointAtParameter(h.getT()) - center).normalized());
+    }
+
     Vector3f center;
     float radius;
 
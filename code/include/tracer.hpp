@@ -10,77 +10,29 @@
 #include "object3d.hpp"
 #include "photon.hpp"
 
-float minTime = 1e-2;
-float minPower = 1e-5;
+// Ray offset against self intersection, and the power below which a path stops
+extern float minTime;
+extern float minPower;
+
+// Surfaces a photon path has bounced off so far
+enum PathType {
+    PATH_DIRECT,    // none
+    PATH_CAUSTIC,   // specular only
+    PATH_DIFFUSE    // at least one diffuse
+};
 
 struct Trace {
     Photon photon;
-    Vector3f normal;
     Material *material;
+    bool caustic;       // stored at the end of a specular-only photon path
 };
 
-Vector3f randomDiffuse(const Vector3f &normal) {
-    Vector3f dir;
-    do {
-        dir[0] = 2.0 * rand() / RAND_MAX - 1;
-        dir[1] = 2.0 * rand() / RAND_MAX - 1;
-        dir[2] = 2.0 * rand() / RAND_MAX - 1;
-    } while (dir.squaredLength() > 1 || Vector3f::dot(dir, normal) <= 0);
-    return dir.normalized();
-}
+Vector3f randomDiffuse(const Vector3f &normal);
 
-void traceRay(Object3D *o, const Ray &r, const Vector3f &power, int depth, std::vector<Trace> &data, bool sampleDiffuse) {
-    if (depth > 0) {
-        Hit h;
-        bool flag = o->intersect(r, h, minTime);
-        if (flag) {
-            Vector3f Ori = r.pointAtParameter(h.getT());
-            Vector3f specularPower = power * h.getMaterial()->specularRatio;
-            Vector3f diffusePower = power - specularPower;
-            if (diffusePower.length() > minPower) {
-                Trace t;
-                t.photon.pos = Ori;
-                t.photon.dir = r.getDirection();
-                t.photon.power = diffusePower;
-                t.normal = h.getNormal();
-                t.material = h.getMaterial();
-                data.push_back(t);
-                if (sampleDiffuse && rand() < RAND_MAX * 0.2) {
-                    // Diffuse
-                    Vector3f dir = randomDiffuse(h.getNormal());
-                    Ray diffuseRay(Ori, dir);
-                    traceRay(o, diffuseRay, diffusePower, depth - 1, data, sampleDiffuse);
-                }
-            }
-            if (specularPower.length() > minPower) {
-                float cosI = Vector3f::dot(r.getDirection(), h.getNormal());
-                float sinI = sqrt(1 - cosI * cosI);
-                float sinR;
-                Vector3f proj = cosI * h.getNormal();
-                Vector3f reflectionDir = r.getDirection() - 2 * proj;
-                if (cosI < 0) {
-                    // In-going ray
-                    sinR = sinI / h.getMaterial()->refraction;
-                }
-                else {
-                    // Out-going ray
-                    sinR = sinI * h.getMaterial()->refraction;
-                    if (sinR > 1) {
-                        // Total reflection
-                        traceRay(o, Ray(Ori, reflectionDir), specularPower, depth - 1, data, sampleDiffuse);
-                    }
-                }
-                float cosR = sqrt(1 - sinR * sinR);
-                cosI = std::abs(cosI);
-                Vector3f refractionDir = (r.getDirection() - proj) * sinR / sinI + proj * cosR / cosI;
-                float sqrtRs = (cosI * sinR - sinI * cosR) / (cosI * sinR + sinI * cosR);
-                float sqrtRp = (cosI * cosR - sinI * sinR) / (cosI * cosR + sinI * sinR);
-                float R = (sqrtRs * sqrtRs + sqrtRp * sqrtRp) / 2, T = 1 - R;
-                traceRay(o, Ray(Ori, reflectionDir), specularPower * R, depth - 1, data, sampleDiffuse);
-                traceRay(o, Ray(Ori, refractionDir), specularPower * T, depth - 1, data, sampleDiffuse);
-            }
-        }
-    }
-}
+// Trace a path of the given power, recording a Trace at every diffuse hit
+// that Shade can light, with the normal facing the incoming ray.
+// sampleDiffuse continues the path off diffuse surfaces (photon tracing).
+void traceRay(Object3D *o, const Ray &r, const Vector3f &power, int depth, std::vector<Trace> &data, bool sampleDiffuse,
+              PathType path = PATH_DIRECT);
 
 #endif // TRACER_H
@@ -4,41 +4,57 @@
 #include <vecmath.h>
 #include "object3d.hpp"
 
-// transforms a 3D point using a matrix, returning a 3D point
-static Vector3f transformPoint(const Matrix4f &mat, const Vector3f &point) {
-    return (mat * Vector4f(point, 1)).xyz();
-}
-
-// transform a 3D directino using a matrix, returning a direction
-static Vector3f transformDirection(const Matrix4f &mat, const Vector3f &dir) {
-    return (mat * Vector4f(dir, 0)).xyz();
-}
-
 class Transform : public Object3D {
 public:
     Transform() {}
 
     Transform(const Matrix4f &m, Object3D *obj) : o(obj) {
-        transformInverse = m.inverse();
+        // Only the affine part is used: the rows of the inverse 3x3, its
+        // translation, and the normal matrix (inverse transposed).
+        Matrix4f transformInverse = m.inverse();
+        for (int i = 0; i < 3; ++i) {
+            inverseRows[i] = Vector3f(transformInverse(i, 0), transformInverse(i, 1), transformInverse(i, 2));
+            normalRows[i] = Vector3f(transformInverse(0, i), transformInverse(1, i), transformInverse(2, i));
+        }
+        inverseTranslation = Vector3f(transformInverse(0, 3), transformInverse(1, 3), transformInverse(2, 3));
     }
 
     ~Transform() {
     }
 
     virtual bool intersect(const Ray &r, Hit &h, float tmin) {
-        Vector3f trSource = transformPoint(transformInverse, r.getOrigin());
-        Vector3f trDirection = transformDirection(transformInverse, r.getDirection());
-        Ray tr(trSource, trDirection);
-        bool inter = o->intersect(tr, h, tmin);
+        bool inter = o->intersect(toObject(r), h, tmin);
         if (inter) {
-            h.set(h.getT(), h.getMaterial(), transformDirection(transformInverse.transposed(), h.getNormal()).normalized());
+            // the normal is brought to world space by Hit::finalize
+            h.pushTransform(this);
         }
         return inter;
     }
 
+    // Parent space ray to object space.  The direction is not renormalized,
+    // so t is the same in both spaces.
+    Ray toObject(const Ray &r) const {
+        const Vector3f &origin = r.getOrigin(), &dir = r.getDirection();
+        return Ray(Vector3f(Vector3f::dot(inverseRows[0], origin),
+                            Vector3f::dot(inverseRows[1], origin),
+                            Vector3f::dot(inverseRows[2], origin)) + inverseTranslation,
+                   Vector3f(Vector3f::dot(inverseRows[0], dir),
+                            Vector3f::dot(inverseRows[1], dir),
+                            Vector3f::dot(inverseRows[2], dir)));
+    }
+
+    // Object space normal to the parent space, not normalized.
+    Vector3f transformNormal(const Vector3f &n) const {
+        return Vector3f(Vector3f::dot(normalRows[0], n),
+                        Vector3f::dot(normalRows[1], n),
+                        Vector3f::dot(normalRows[2], n));
+    }
+
 protected:
     Object3D *o; //un-transformed object
-    Matrix4f transformInverse;
+    Vector3f inverseRows[3];
+    Vector3f inverseTranslation;
+    Vector3f normalRows[3];
 };
 
 #endif //TRANSFORM_H
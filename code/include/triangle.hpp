@@ -2,11 +2,74 @@
 #define TRIANGLE_H
 
 #include "object3d.hpp"
+#include "profiler.hpp"
 #include <vecmath.h>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 using namespace std;
 
+// Ray / triangle tests returning the ray parameter of the hit in t and the
+// barycentric weights u, v of the second and third vertex.  Both accept
+// either winding.
+
+// Moller-Trumbore with the edges e1 = b - a and e2 = c - a precomputed.
+inline bool intersectTriangle(const Vector3f &a, const Vector3f &e1, const Vector3f &e2, const Ray &r, float &t, float &u, float &v) {
+	const Vector3f &d = r.getDirection();
+	Vector3f p = Vector3f::cross(d, e2);
+	float det = Vector3f::dot(e1, p);
+	if (det == 0)
+		return false;
+	float invDet = 1 / det;
+	Vector3f s = r.getOrigin() - a;
+	u = Vector3f::dot(s, p) * invDet;
+	if (u < 0 || u > 1)
+		return false;
+	Vector3f q = Vector3f::cross(s, e1);
+	v = Vector3f::dot(d, q) * invDet;
+	if (v < 0 || u + v > 1)
+		return false;
+	t = Vector3f::dot(e2, q) * invDet;
+	return true;
+}
+
+// Watertight test of Woop, Benthin and Wald (JCGT 2013).  Works on the
+// vertices themselves, so triangles sharing an edge never both miss a ray
+// that crosses it.
+inline bool intersectTriangleWatertight(const Vector3f &a, const Vector3f &b, const Vector3f &c, const Ray &r, float &t, float &u, float &v) {
+	const Vector3f &d = r.getDirection();
+	int kz = 0;
+	if (std::abs(d[1]) > std::abs(d[kz])) kz = 1;
+	if (std::abs(d[2]) > std::abs(d[kz])) kz = 2;
+	int kx = (kz + 1) % 3, ky = (kx + 1) % 3;
+	if (d[kz] < 0)
+		std::swap(kx, ky);
+	float sx = d[kx] / d[kz], sy = d[ky] / d[kz], sz = 1 / d[kz];
+	Vector3f A = a - r.getOrigin(), B = b - r.getOrigin(), C = c - r.getOrigin();
+	float ax = A[kx] - sx * A[kz], ay = A[ky] - sy * A[kz];
+	float bx = B[kx] - sx * B[kz], by = B[ky] - sy * B[kz];
+	float cx = C[kx] - sx * C[kz], cy = C[ky] - sy * C[kz];
+	float wa = cx * by - cy * bx;
+	float wb = ax * cy - ay * cx;
+	float wc = bx * ay - by * ax;
+	if (wa == 0 || wb == 0 || wc == 0) {
+		// on an edge in float, decide in double
+		wa = (float) ((double) cx * by - (double) cy * bx);
+		wb = (float) ((double) ax * cy - (double) ay * cx);
+		wc = (float) ((double) bx * ay - (double) by * ax);
+	}
+	if ((wa < 0 || wb < 0 || wc < 0) && (wa > 0 || wb > 0 || wc > 0))
+		return false;
+	float det = wa + wb + wc;
+	if (det == 0)
+		return false;
+	float invDet = 1 / det;
+	t = (wa * sz * A[kz] + wb * sz * B[kz] + wc * sz * C[kz]) * invDet;
+	u = wb * invDet;
+	v = wc * invDet;
+	return true;
+}
+
 class Triangle: public Object3D {
 
 public:
@@ -17,30 +80,35 @@ public:
 		vertices[0] = a;
 		vertices[1] = b;
 		vertices[2] = c;
-        normal = Vector3f::cross(b - a, c - a).normalized();
+		edges[0] = b - a;
+		edges[1] = c - a;
+        normal = Vector3f::cross(edges[0], edges[1]).normalized();
 	}
 
 	bool intersect( const Ray& ray,  Hit& hit , float tmin) override {
-		Vector3f Rd = ray.getDirection();
-		Vector3f E1 = vertices[0] - vertices[1];
-		Vector3f E2 = vertices[0] - vertices[2];
-		Vector3f S = vertices[0] - ray.getOrigin();
-		float D0 = Matrix3f(Rd, E1, E2, true).determinant();
-		if (D0 == 0)
+		PJ_COUNT(COUNTER_TRIANGLE_TESTS);
+		float t, u, v;
+#ifdef PJ_WATERTIGHT
+		if (!intersectTriangleWatertight(vertices[0], vertices[1], vertices[2], ray, t, u, v))
 			return false;
-		float D1 = Matrix3f(S, E1, E2, true).determinant();
-		float D2 = Matrix3f(Rd, S, E2, true).determinant();
-		float D3 = Matrix3f(Rd, E1, S, true).determinant();
-		float t = D1 / D0, beta = D2 / D0, gamma = D3 / D0;
-		if (t > tmin && beta >= 0 && gamma >= 0 && beta + gamma <= 1 && t < hit.getT()) {
-			hit.set(t, material, normal);
+#else
+		if (!intersectTriangle(vertices[0], edges[0], edges[1], ray, t, u, v))
+			return false;
+#endif
+		if (t > tmin && t < hit.getT()) {
+			hit.record(t, this, 0, u, v);
 			return true;
 		}
 		return false;
 	}
+
+	void computeShading(const Ray &ray, Hit &hit) const override {
+		hit.setShading(material, normal);
+	}
 	
 	Vector3f normal;
 	Vector3f vertices[3];
+	Vector3f edges[2];
 	
 protected:
 
@@ -0,0 +1,65 @@
+#include "emission_guide.hpp"
+#include "random.hpp"
+
+#include <algorithm>
+
+// Share of every light's photons emitted uniformly
+static const float GUIDE_UNIFORM = 0.2;
+
+EmissionGuide::EmissionGuide() {
+    reset(0);
+}
+
+void EmissionGuide::reset(int lightNum) {
+    lightNum = std::min(lightNum, MAX_LIGHTS);
+    counts.assign(lightNum * CELLS, 0);
+    cdf.resize(lightNum * CELLS);
+    for (int i = 0; i < (int) cdf.size(); ++i) {
+        cdf[i] = (float) (i % CELLS + 1) / CELLS;
+    }
+}
+
+std::pair<Ray, Vector3f> EmissionGuide::generate(const Light *light, int li, unsigned short &cell,
+                                                 float &weight) const {
+    if (li >= MAX_LIGHTS || (li + 1) * CELLS > (int) cdf.size()) {
+        cell = NO_EMISSION_CELL;
+        weight = 1;
+        return light->generate();
+    }
+    const float *lightCdf = &cdf[li * CELLS];
+    float x = random01();
+    int c = std::min((int) (std::lower_bound(lightCdf, lightCdf + CELLS, x) - lightCdf), CELLS - 1);
+    float pdf = (lightCdf[c] - (c > 0 ? lightCdf[c - 1] : 0)) * CELLS;
+
+    // Uniform inside the cell, one cell index digit per dimension
+    float u[4];
+    for (int d = 0, index = c; d < 4; ++d, index /= RESOLUTION) {
+        u[d] = (index % RESOLUTION + random01()) / RESOLUTION;
+    }
+    cell = (unsigned short) (li * CELLS + c);
+    weight = 1 / pdf;
+    return light->generate(u);
+}
+
+void EmissionGuide::record(const std::vector<float> &gathered) {
+    for (int i = 0; i < (int) counts.size() && i < (int) gathered.size(); ++i) {
+        counts[i] += gathered[i];
+    }
+}
+
+void EmissionGuide::update() {
+    for (int li = 0; li * CELLS < (int) counts.size(); ++li) {
+        const float *lightCounts = &counts[li * CELLS];
+        float total = 0;
+        for (int c = 0; c < CELLS; ++c) {
+            total += lightCounts[c];
+        }
+        float sum = 0;
+        for (int c = 0; c < CELLS; ++c) {
+            float share = total > 0 ? lightCounts[c] / total : 1.0f / CELLS;
+            sum += GUIDE_UNIFORM / CELLS + (1 - GUIDE_UNIFORM) * share;
+            cdf[li * CELLS + c] = sum;
+        }
+        cdf[li * CELLS + CELLS - 1] = 1;
+    }
+}
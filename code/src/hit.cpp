@@ -0,0 +1,23 @@
+#include "hit.hpp"
+#include "object3d.hpp"
+#include "transform.hpp"
+
+void Hit::finalize(const Ray &r) {
+    if (object != nullptr) {
+        // the ray in the space the object recorded the hit in
+        Ray objRay = r;
+        for (int i = transformNum - 1; i >= 0; --i) {
+            objRay = transforms[i]->toObject(objRay);
+        }
+        object->computeShading(objRay, *this);
+        object = nullptr;
+    }
+    if (transformNum == 0) {
+        return;
+    }
+    for (int i = 0; i < transformNum; ++i) {
+        normal = transforms[i]->transformNormal(normal);
+    }
+    normal.normalize();
+    transformNum = 0;
+}
@@ -217,7 +217,7 @@ struct BMPHeader
                              are important */
 };
 int 
-Image::SaveBMP(const char *filename)
+Image::SaveBMP(const char *filename) const
 {
     int i, j, ipos;
     int bytesPerLine;
@@ -290,11 +290,143 @@ Image::SaveBMP(const char *filename)
     return(1);
 }
 
-void Image::SaveImage(const char * filename)
+// Save portable float map (.pfm) files: color "PF" header, negative
+// scale for little-endian data, rows stored bottom to top
+
+int Image::SavePFM(const char *filename) const
+{
+    assert(filename != NULL);
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) return(0);
+    fprintf(file, "PF\n%d %d\n-1.0\n", width, height);
+
+    float *line = (float *)malloc(sizeof(float) * 3 * width);
+    if (line == NULL)
+    {
+        fprintf(stderr, "Can't allocate memory for PFM file.\n");
+        fclose(file);
+        return(0);
+    }
+    // y = 0 is the bottom row, same as SaveBMP
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const Vector3f &v = data[y * width + x];
+            line[3*x] = v[0];
+            line[3*x+1] = v[1];
+            line[3*x+2] = v[2];
+        }
+        fwrite(line, sizeof(float), 3 * width, file);
+    }
+
+    free(line);
+    fclose(file);
+    return(1);
+}
+
+// Save single-part scanline OpenEXR (.exr) files with no compression
+// and 32-bit float B, G, R channels.  Uncompressed blocks have a fixed
+// size, so the offset table is known before any pixel is written.
+
+static void WriteAttribute(FILE *file, const char *name, const char *type,
+                           int size, const void *value)
+{
+    fwrite(name, strlen(name) + 1, 1, file);
+    fwrite(type, strlen(type) + 1, 1, file);
+    fwrite(&size, 4, 1, file);
+    fwrite(value, size, 1, file);
+}
+
+int Image::SaveEXR(const char *filename) const
+{
+    assert(filename != NULL);
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) return(0);
+
+    int magic = 20000630;
+    int version = 2;
+    fwrite(&magic, 4, 1, file);
+    fwrite(&version, 4, 1, file);
+
+    // channels must be listed in alphabetical order
+    unsigned char chlist[3 * 18 + 1];
+    int chPos = 0;
+    const char names[3] = {'B', 'G', 'R'};
+    for (int c = 0; c < 3; c++)
+    {
+        int pixelType = 2;  // FLOAT
+        int sampling = 1;
+        chlist[chPos++] = names[c];
+        chlist[chPos++] = 0;
+        memcpy(chlist + chPos, &pixelType, 4); chPos += 4;
+        memset(chlist + chPos, 0, 4); chPos += 4;  // pLinear + reserved
+        memcpy(chlist + chPos, &sampling, 4); chPos += 4;
+        memcpy(chlist + chPos, &sampling, 4); chPos += 4;
+    }
+    chlist[chPos++] = 0;
+    WriteAttribute(file, "channels", "chlist", chPos, chlist);
+
+    unsigned char compression = 0;  // NO_COMPRESSION
+    WriteAttribute(file, "compression", "compression", 1, &compression);
+    int window[4] = {0, 0, width - 1, height - 1};
+    WriteAttribute(file, "dataWindow", "box2i", 16, window);
+    WriteAttribute(file, "displayWindow", "box2i", 16, window);
+    unsigned char lineOrder = 0;  // INCREASING_Y
+    WriteAttribute(file, "lineOrder", "lineOrder", 1, &lineOrder);
+    float aspect = 1;
+    WriteAttribute(file, "pixelAspectRatio", "float", 4, &aspect);
+    float center[2] = {0, 0};
+    WriteAttribute(file, "screenWindowCenter", "v2f", 8, center);
+    float windowWidth = 1;
+    WriteAttribute(file, "screenWindowWidth", "float", 4, &windowWidth);
+    fputc(0, file);
+
+    // offset table, one entry per scanline block
+    int bytesPerLine = 3 * width * (int) sizeof(float);
+    long long offset = ftell(file) + 8LL * height;
+    for (int i = 0; i < height; i++)
+    {
+        fwrite(&offset, 8, 1, file);
+        offset += 8 + bytesPerLine;
+    }
+
+    float *line = (float *)malloc(bytesPerLine);
+    if (line == NULL)
+    {
+        fprintf(stderr, "Can't allocate memory for EXR file.\n");
+        fclose(file);
+        return(0);
+    }
+    // EXR scanlines run top to bottom, so flip y
+    for (int i = 0; i < height; i++)
+    {
+        const Vector3f *row = data + (height - 1 - i) * width;
+        for (int x = 0; x < width; x++)
+        {
+            line[x] = row[x][2];
+            line[width + x] = row[x][1];
+            line[2 * width + x] = row[x][0];
+        }
+        fwrite(&i, 4, 1, file);
+        fwrite(&bytesPerLine, 4, 1, file);
+        fwrite(line, bytesPerLine, 1, file);
+    }
+
+    free(line);
+    fclose(file);
+    return(1);
+}
+
+void Image::SaveImage(const char * filename) const
 {
 	int len = strlen(filename);
 	if(strcmp(".bmp", filename+len-4)==0){
 		SaveBMP(filename);
+	}else if(strcmp(".pfm", filename+len-4)==0){
+		SavePFM(filename);
+	}else if(strcmp(".exr", filename+len-4)==0){
+		SaveEXR(filename);
 	}else{
 		SaveTGA(filename);
 	}
@@ -1,4 +1,5 @@
 #include "kdtree.hpp"
+#include "profiler.hpp"
 #include <algorithm>
 
 void KDTree::build(std::vector<int> &triId, int depth, int d) {
@@ -64,10 +65,7 @@ bool KDTree::intersect(const Ray &r, Hit &h, float tmin) {
     if (!leafTriId.empty()) {
         bool flag = false;
         for (int &i: leafTriId) {
-            Triangle triangle(mesh->v[mesh->t[i][0]], 
-                              mesh->v[mesh->t[i][1]], 
-                              mesh->v[mesh->t[i][2]], mesh->material);
-            flag |= triangle.intersect(r, h, tmin);
+            flag |= mesh->intersectTriangle(i, r, h, tmin);
         }
         return flag;
     }
@@ -104,7 +102,43 @@ void KDTree::getBox(std::vector<int> &triId) {
     }
 }
 
+int KDTree::flatten(std::vector<KDTreeNode> &nodes, std::vector<int> &leafIds) const {
+    int index = (int) nodes.size();
+    KDTreeNode node;
+    for (int d = 0; d < 3; ++d) {
+        node.box[0][d] = box[0][d];
+        node.box[1][d] = box[1][d];
+    }
+    node.dim = dim;
+    node.leafBegin = (int) leafIds.size();
+    node.leafSize = (int) leafTriId.size();
+    leafIds.insert(leafIds.end(), leafTriId.begin(), leafTriId.end());
+    nodes.push_back(node);
+    int l = left != nullptr ? left->flatten(nodes, leafIds) : -1;
+    int r = right != nullptr ? right->flatten(nodes, leafIds) : -1;
+    nodes[index].left = l;
+    nodes[index].right = r;
+    return index;
+}
+
+void KDTree::restore(const KDTreeNode *nodes, int index, const int *leafIds) {
+    const KDTreeNode &node = nodes[index];
+    box[0] = Vector3f(node.box[0][0], node.box[0][1], node.box[0][2]);
+    box[1] = Vector3f(node.box[1][0], node.box[1][1], node.box[1][2]);
+    dim = node.dim;
+    leafTriId.assign(leafIds + node.leafBegin, leafIds + node.leafBegin + node.leafSize);
+    if (node.left >= 0) {
+        left = new KDTree(mesh);
+        left->restore(nodes, node.left, leafIds);
+    }
+    if (node.right >= 0) {
+        right = new KDTree(mesh);
+        right->restore(nodes, node.right, leafIds);
+    }
+}
+
 bool KDTree::intersectBox(const Ray &r, float tmin) {
+    PJ_COUNT(COUNTER_BOX_TESTS);
     float t1 = -1e38, t2 = 1e38;
     for (int d = 0; d < 3; ++d) {
         if (r.getDirection()[d] > 0) {
@@ -5,68 +5,175 @@
 #include <cmath>
 #include <iostream>
 
-// #include "kdtree.hpp"
-#include "scene_parser.hpp"
 #include "image.hpp"
-#include "camera.hpp"
-#include "group.hpp"
-#include "light.hpp"
-#include "ppm.hpp"
+#include "profiler.hpp"
+#include "renderer.hpp"
 
 #include <string>
 
-int main(int argc, char *argv[]) {
-    for (int argNum = 1; argNum < argc; ++argNum) {
-        std::cout << "Argument " << argNum << " is: " << argv[argNum] << std::endl;
+void printCounters() {
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        std::cout << counterName((Counter) c) << ": " << getCounter((Counter) c) << std::endl;
     }
+}
 
-    if (argc != 3) {
-        std::cout << "Usage: ./bin/PJ <input scene file> <output bmp file>" << std::endl;
+// Render a fixed number of passes on each scene without writing images
+// and report the time spent in every phase as JSON.
+int runBenchmark(int argc, char *argv[], RenderSettings settings, const char *traceFile) {
+    int passes = 10;
+    const char *output = nullptr;
+    std::vector<std::string> scenes;
+    for (int argNum = 2; argNum < argc; ++argNum) {
+        if (!strcmp(argv[argNum], "--passes") && argNum + 1 < argc) {
+            passes = atoi(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--photons") && argNum + 1 < argc) {
+            settings.photons = atoi(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--spp") && argNum + 1 < argc) {
+            settings.spp = atoi(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "-o") && argNum + 1 < argc) {
+            output = argv[++argNum];
+        } else {
+            scenes.push_back(argv[argNum]);
+        }
+    }
+    if (scenes.empty()) {
+        std::cout << "Usage: ./bin/PJ --benchmark [--passes N] [--photons N] [--spp N] [-o <json file>] <scene file>..." << std::endl;
         return 1;
     }
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];  // only bmp is allowed.
 
-    // First, parse the scene using SceneParser.
-    // Then loop over each pixel in the image, shooting a ray
-    // through that pixel and finding its intersection with
-    // the scene.  Write the color at the intersection to that
-    // pixel in your output image.
-    SceneParser sceneparser(inputFile.c_str());
-    Camera* camera = sceneparser.getCamera();
-    Group* baseGroup = sceneparser.getGroup();
+    std::string json = "{\n  \"engine\": \"" + std::string(settings.engine == ENGINE_PPM ? "ppm" : "sppm")
+                     + "\",\n  \"passes\": " + std::to_string(passes)
+                     + ",\n  \"photons_per_light\": " + std::to_string(settings.photons)
+                     + ",\n  \"caustic_photons_per_light\": " + std::to_string(settings.causticPhotons)
+                     + ",\n  \"guided\": " + (settings.guided ? "true" : "false")
+                     + ",\n  \"spp\": " + std::to_string(settings.spp)
+                     + ",\n  \"scenes\": [\n";
+    for (int sceneId = 0; sceneId < (int) scenes.size(); ++sceneId) {
+        resetPhaseTimes();
+        resetCounters();
+        double wallStart = wallSeconds(), cpuStart = cpuSeconds();
+        {
+            Renderer renderer;
+            renderer.loadScene(scenes[sceneId].c_str());
+            renderer.configure(settings);
+            for (int passId = 1; passId <= passes; ++passId) {
+                renderer.renderPass();
+                for (int cameraId = 0; cameraId < renderer.getNumCameras(); ++cameraId) {
+                    renderer.getFramebuffer(cameraId);
+                }
+            }
+        }
+        double wall = wallSeconds() - wallStart, cpu = cpuSeconds() - cpuStart;
 
-    // Build KDTree
-    // KDTree *KDTreeRoot = new KDTree;
-    // std::vector<Box> groupBox;
-    // baseGroup->getBoxes(groupBox);
-    // KDTreeRoot->buildKDTree(groupBox, (int) (8 + 1.3 * log((float) groupBox.size())), 0);
+        char buffer[256];
+        json += "    {\n      \"scene\": \"" + scenes[sceneId] + "\",\n      \"phases\": {\n";
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            const PhaseTime &time = getPhaseTime((Phase) p);
+            snprintf(buffer, sizeof(buffer), "        \"%s\": {\"wall\": %.6f, \"cpu\": %.6f, \"calls\": %lld}%s\n",
+                     phaseName((Phase) p), time.wall, time.cpu, time.calls, p + 1 < PHASE_COUNT ? "," : "");
+            json += buffer;
+        }
+        if (COUNTERS_ENABLED) {
+            json += "      },\n      \"counters\": {\n";
+            for (int c = 0; c < COUNTER_COUNT; ++c) {
+                snprintf(buffer, sizeof(buffer), "        \"%s\": %lld%s\n",
+                         counterName((Counter) c), getCounter((Counter) c), c + 1 < COUNTER_COUNT ? "," : "");
+                json += buffer;
+            }
+        }
+        snprintf(buffer, sizeof(buffer), "      },\n      \"total\": {\"wall\": %.6f, \"cpu\": %.6f}\n    }%s\n",
+                 wall, cpu, sceneId + 1 < (int) scenes.size() ? "," : "");
+        json += buffer;
+    }
+    json += "  ]\n}\n";
 
-    // Save all lights
-    std::vector<Light *> lights;
-    for (int li = 0; li < sceneparser.getNumLights(); ++li) {
-        lights.push_back(sceneparser.getLight(li));
+    FILE *file = output != nullptr ? fopen(output, "w") : stdout;
+    if (file == nullptr) {
+        std::cout << "Cannot open " << output << std::endl;
+        return 1;
+    }
+    fputs(json.c_str(), file);
+    if (file != stdout) {
+        fclose(file);
+    }
+    if (traceFile != nullptr && !writeTrace(traceFile)) {
+        std::cout << "Cannot open " << traceFile << std::endl;
+        return 1;
     }
+    return 0;
+}
 
-    // Set image
-    Image img(camera->getWidth(), camera->getHeight());
+int main(int argc, char *argv[]) {
+    for (int argNum = 1; argNum < argc; ++argNum) {
+        std::cout << "Argument " << argNum << " is: " << argv[argNum] << std::endl;
+    }
+
+    // --trace <file> writes a Chrome trace of the render phases
+    const char *traceFile = nullptr;
+    RenderSettings settings;
+    std::vector<char *> args;
+    for (int argNum = 0; argNum < argc; ++argNum) {
+        if (!strcmp(argv[argNum], "--trace") && argNum + 1 < argc) {
+            traceFile = argv[++argNum];
+        } else if (!strcmp(argv[argNum], "--caustic-photons") && argNum + 1 < argc) {
+            // a separate caustic map with this many photons per light
+            settings.causticPhotons = atoi(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--guided")) {
+            // emit photons where earlier passes found visible ones
+            settings.guided = true;
+        } else if (!strcmp(argv[argNum], "--engine") && argNum + 1 < argc) {
+            if (!parseRenderEngine(argv[++argNum], settings.engine)) {
+                std::cout << "Unknown engine: " << argv[argNum] << std::endl;
+                return 1;
+            }
+        } else {
+            args.push_back(argv[argNum]);
+        }
+    }
+    argc = (int) args.size();
+    argv = args.data();
+    if (traceFile != nullptr) {
+        startTrace();
+    }
+
+    if (argc >= 2 && !strcmp(argv[1], "--benchmark")) {
+        return runBenchmark(argc, argv, settings, traceFile);
+    }
+
+    if (argc != 3 && argc != 4) {
+        std::cout << "Usage: ./bin/PJ [--engine ppm|sppm] [--caustic-photons N] [--guided] [--trace <json file>] <input scene file> <output prefix> [bmp|pfm|exr]" << std::endl;
+        std::cout << "       ./bin/PJ [--engine ppm|sppm] [--caustic-photons N] [--guided] [--trace <json file>] --benchmark [options] <scene file>..." << std::endl;
+        return 1;
+    }
+    std::string inputFile = argv[1];
+    std::string outputFile = argv[2];
+    // bmp is clamped to 8 bits, pfm and exr keep the float radiance.
+    std::string outputFormat = argc == 4 ? argv[3] : "bmp";
+    if (outputFormat != "bmp" && outputFormat != "pfm" && outputFormat != "exr") {
+        std::cout << "Unknown output format: " << outputFormat << std::endl;
+        return 1;
+    }
 
-    // Initialize PPM grid
-    std::vector<std::vector<viewPoint>> imgView;
-    ppmBackward(baseGroup, camera, 8, imgView);
+    Renderer renderer;
+    renderer.loadScene(inputFile.c_str());
+    renderer.configure(settings);
 
-    // SPPM Pass
     for (int passId = 1; passId <= 2500; ++passId) {
-        std::cout << "PPM pass " << passId << std::endl;
-        ppmForward(baseGroup, lights, 200000, imgView);
-        for (int x = 0; x < camera->getWidth(); ++x) {
-            for (int y = 0; y < camera->getHeight(); ++y) {
-                int offset = x * camera->getHeight() + y;
-                img.SetPixel(x, y, getRadiance(imgView[offset]));
-            }
+        std::cout << (settings.engine == ENGINE_PPM ? "PPM" : "SPPM") << " pass " << passId << std::endl;
+        renderer.renderPass();
+        // <prefix><pass>, or <prefix>cam<camera>_<pass> for several cameras
+        for (int cameraId = 0; cameraId < renderer.getNumCameras(); ++cameraId) {
+            std::string prefix = renderer.getNumCameras() > 1 ? outputFile + "cam" + std::to_string(cameraId) + "_" : outputFile;
+            renderer.getFramebuffer(cameraId).SaveImage((prefix + std::to_string(passId) + "." + outputFormat).c_str());
+        }
+        if (COUNTERS_ENABLED) {
+            printCounters();
+            resetCounters();
         }
-        img.SaveImage((outputFile + std::to_string(passId) + ".bmp").c_str());
+    }
+    if (traceFile != nullptr && !writeTrace(traceFile)) {
+        std::cout << "Cannot open " << traceFile << std::endl;
+        return 1;
     }
     return 0;
 }
-
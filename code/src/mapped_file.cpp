@@ -0,0 +1,39 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const char *filename) {
+    begin = nullptr;
+    length = 0;
+    opened = false;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        length = (size_t) st.st_size;
+        if (length == 0) {
+            // mmap rejects empty ranges, but an empty file is still valid
+            opened = true;
+        }
+        else {
+            void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, length, MADV_SEQUENTIAL);
+                begin = (const char *) p;
+                opened = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (begin != nullptr) {
+        munmap((void *) begin, length);
+    }
+}
@@ -1,88 +1,227 @@
 #include "mesh.hpp"
 #include "kdtree.hpp"
-#include <fstream>
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "profiler.hpp"
+#include "number_parser.hpp"
 #include <iostream>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <utility>
-#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 bool Mesh::intersect(const Ray &r, Hit &h, float tmin) {
     if (root) {
         return root->intersect(r, h, tmin);
     }
     bool result = false;
-    for (int triId = 0; triId < (int) t.size(); ++triId) {
-        TriangleIndex& triIndex = t[triId];
-        Triangle triangle(v[triIndex[0]],
-                          v[triIndex[1]], v[triIndex[2]], material);
-        result |= triangle.intersect(r, h, tmin);
+    for (int triId = 0; triId < (int) tri.size(); ++triId) {
+        result |= intersectTriangle(triId, r, h, tmin);
     }
     return result;
 }
 
-Mesh::Mesh(const char *filename, Material *material) : Object3D(material) {
+Mesh::~Mesh() {
+    delete root;
+}
 
-    std::ifstream f;
-    f.open(filename);
-    if (!f.is_open()) {
-        std::cout << "Cannot open " << filename << "\n";
-        return;
+void Mesh::buildTriangles() {
+    tri.resize(t.size());
+    for (int triId = 0; triId < (int) t.size(); ++triId) {
+        TriangleIndex &triIndex = t[triId];
+        TriangleData &d = tri[triId];
+        d.v0 = v[triIndex[0]];
+        d.e1 = v[triIndex[1]] - d.v0;
+        d.e2 = v[triIndex[2]] - d.v0;
+        d.normal = Vector3f::cross(d.e1, d.e2).normalized();
+    }
+}
+
+namespace {
+
+// Relative (negative) face indices are resolved against the vertex count
+// of the chunk they appear in, which is only known after all chunks have
+// been parsed.  They are stored as chunk-local indices shifted down by
+// this bias, clear of -1 which marks a missing index.
+const int RELATIVE_BIAS = 1 << 30;
+
+struct ObjChunk {
+    std::vector<Vector3f> v, vn;
+    std::vector<Vector2f> vt;
+    std::vector<Mesh::TriangleIndex> t, tt, tn;
+    bool hasTex = false, hasNormal = false;
+};
+
+int objIndex(int raw, int localCount) {
+    if (raw > 0) {
+        return raw - 1;
+    }
+    if (raw < 0) {
+        return localCount + raw - RELATIVE_BIAS;
     }
-    std::string line;
-    std::string vTok("v");
-    std::string fTok("f");
-    std::string texTok("vt");
-    char bslash = '/', space = ' ';
-    std::string tok;
-    int texID;
-    while (true) {
-        std::getline(f, line);
-        if (f.eof()) {
-            break;
+    return -1;
+}
+
+int resolveIndex(int index, int chunkBase) {
+    return index < -1 ? index + RELATIVE_BIAS + chunkBase : index;
+}
+
+// Parses one face corner "v", "v/vt", "v//vn" or "v/vt/vn".
+bool parseCorner(const char *&p, const char *end, const ObjChunk &c, int corner[3]) {
+    int raw;
+    if (!parseInt(p, end, raw)) {
+        return false;
+    }
+    corner[0] = objIndex(raw, (int) c.v.size());
+    corner[1] = corner[2] = -1;
+    if (p < end && *p == '/') {
+        ++p;
+        if (p < end && *p != '/' && parseInt(p, end, raw)) {
+            corner[1] = objIndex(raw, (int) c.vt.size());
         }
-        if (line.size() < 3) {
-            continue;
+        if (p < end && *p == '/') {
+            ++p;
+            if (parseInt(p, end, raw)) {
+                corner[2] = objIndex(raw, (int) c.vn.size());
+            }
         }
-        if (line.at(0) == '#') {
-            continue;
+    }
+    return true;
+}
+
+void parseObjChunk(const char *p, const char *end, ObjChunk &c) {
+    while (p < end) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == nullptr) {
+            eol = end;
         }
-        std::stringstream ss(line);
-        ss >> tok;
-        if (tok == vTok) {
+        const char *q = skipBlanks(p, eol);
+        if (eol - q >= 2 && q[0] == 'v' && isBlank(q[1])) {
             Vector3f vec;
-            ss >> vec[0] >> vec[1] >> vec[2];
-            v.push_back(vec);
-        } else if (tok == fTok) {
-            if (line.find(bslash) != std::string::npos) {
-                std::replace(line.begin(), line.end(), bslash, space);
-                std::stringstream facess(line);
-                TriangleIndex trig;
-                facess >> tok;
-                for (int ii = 0; ii < 3; ii++) {
-                    facess >> trig[ii] >> texID;
-                    trig[ii]--;
-                }
-                t.push_back(trig);
-            } else {
-                TriangleIndex trig;
-                for (int ii = 0; ii < 3; ii++) {
-                    ss >> trig[ii];
-                    trig[ii]--;
+            q += 2;
+            parseFloat(q, eol, vec[0]) && parseFloat(q, eol, vec[1]) && parseFloat(q, eol, vec[2]);
+            c.v.push_back(vec);
+        }
+        else if (eol - q >= 3 && q[0] == 'v' && q[1] == 't' && isBlank(q[2])) {
+            Vector2f texcoord;
+            q += 3;
+            parseFloat(q, eol, texcoord[0]) && parseFloat(q, eol, texcoord[1]);
+            c.vt.push_back(texcoord);
+        }
+        else if (eol - q >= 3 && q[0] == 'v' && q[1] == 'n' && isBlank(q[2])) {
+            Vector3f normal;
+            q += 3;
+            parseFloat(q, eol, normal[0]) && parseFloat(q, eol, normal[1]) && parseFloat(q, eol, normal[2]);
+            c.vn.push_back(normal);
+        }
+        else if (eol - q >= 2 && q[0] == 'f' && isBlank(q[1])) {
+            // Polygons are split into a triangle fan around the first corner.
+            int first[3], prev[3], cur[3];
+            q += 2;
+            if (parseCorner(q, eol, c, first) && parseCorner(q, eol, c, prev)) {
+                while (parseCorner(q, eol, c, cur)) {
+                    c.t.emplace_back(first[0], prev[0], cur[0]);
+                    c.tt.emplace_back(first[1], prev[1], cur[1]);
+                    c.tn.emplace_back(first[2], prev[2], cur[2]);
+                    c.hasTex |= first[1] != -1 || prev[1] != -1 || cur[1] != -1;
+                    c.hasNormal |= first[2] != -1 || prev[2] != -1 || cur[2] != -1;
+                    std::copy(cur, cur + 3, prev);
                 }
-                t.push_back(trig);
             }
-        } else if (tok == texTok) {
-            Vector2f texcoord;
-            ss >> texcoord[0];
-            ss >> texcoord[1];
         }
+        p = eol + 1;
+    }
+}
+
+template <typename T>
+void appendChunks(std::vector<ObjChunk> &chunks, std::vector<T> ObjChunk::*member, std::vector<T> &out) {
+    std::vector<size_t> base(chunks.size() + 1, 0);
+    for (size_t ci = 0; ci < chunks.size(); ++ci) {
+        base[ci + 1] = base[ci] + (chunks[ci].*member).size();
+    }
+    out.resize(base.back());
+    #pragma omp parallel for schedule(static)
+    for (int ci = 0; ci < (int) chunks.size(); ++ci) {
+        std::vector<T> &part = chunks[ci].*member;
+        std::copy(part.begin(), part.end(), out.begin() + base[ci]);
+        std::vector<T>().swap(part);
+    }
+}
+
+} // namespace
+
+Mesh::Mesh(const char *filename, Material *material) : Object3D(material) {
+    root = nullptr;
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cout << "Cannot open " << filename << "\n";
+        return;
+    }
+    uint64_t sourceHash = hashMeshSource(file.data(), file.size());
+    if (loadMeshCache(filename, sourceHash, this)) {
+        buildTriangles();
+        std::cout << "Loaded " << filename << " from mesh cache\n";
+        return;
+    }
+
+    // Split the file into line-aligned chunks of at least 1MB and parse
+    // them in parallel.
+    const char *begin = file.data(), *end = file.data() + file.size();
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    size_t chunkNum = std::max<size_t>(1, std::min<size_t>(threads * 4, file.size() >> 20));
+    std::vector<const char *> bound(chunkNum + 1, end);
+    bound[0] = begin;
+    for (size_t ci = 1; ci < chunkNum; ++ci) {
+        const char *p = std::max(bound[ci - 1], begin + file.size() / chunkNum * ci);
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        bound[ci] = eol == nullptr ? end : eol + 1;
+    }
+    std::vector<ObjChunk> chunks(chunkNum);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int ci = 0; ci < (int) chunkNum; ++ci) {
+        parseObjChunk(bound[ci], bound[ci + 1], chunks[ci]);
+    }
+
+    // Rebase relative indices before the per-chunk arrays are released.
+    bool hasTex = false, hasNormal = false;
+    int vBase = 0, vtBase = 0, vnBase = 0;
+    for (ObjChunk &c: chunks) {
+        for (size_t i = 0; i < c.t.size(); ++i) {
+            for (int k = 0; k < 3; ++k) {
+                c.t[i][k] = resolveIndex(c.t[i][k], vBase);
+                c.tt[i][k] = resolveIndex(c.tt[i][k], vtBase);
+                c.tn[i][k] = resolveIndex(c.tn[i][k], vnBase);
+            }
+        }
+        hasTex |= c.hasTex;
+        hasNormal |= c.hasNormal;
+        vBase += (int) c.v.size();
+        vtBase += (int) c.vt.size();
+        vnBase += (int) c.vn.size();
+    }
+    appendChunks(chunks, &ObjChunk::v, v);
+    appendChunks(chunks, &ObjChunk::vt, vt);
+    appendChunks(chunks, &ObjChunk::vn, vn);
+    appendChunks(chunks, &ObjChunk::t, t);
+    if (hasTex) {
+        appendChunks(chunks, &ObjChunk::tt, tt);
+    }
+    if (hasNormal) {
+        appendChunks(chunks, &ObjChunk::tn, tn);
     }
-    f.close();
     buildKDTree();
+    saveMeshCache(filename, sourceHash, this);
 }
 
 void Mesh::buildKDTree() {
+    ScopedPhase phase(PHASE_ACCEL_BUILD);
+    buildTriangles();
     root = new KDTree(this);
     std::vector<int> triId;
     for (int i = 0; i < (int) t.size(); ++i) {
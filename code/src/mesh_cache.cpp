@@ -0,0 +1,215 @@
+#include "mesh_cache.hpp"
+#include "mesh.hpp"
+#include "kdtree.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Bump whenever the layout below or the KDTree build changes.
+const uint32_t CACHE_VERSION = 1;
+const char CACHE_MAGIC[8] = {'P', 'J', 'M', 'E', 'S', 'H', 0, 0};
+
+static_assert(sizeof(Vector3f) == 3 * sizeof(float), "Vector3f must be tightly packed");
+static_assert(sizeof(Vector2f) == 2 * sizeof(float), "Vector2f must be tightly packed");
+static_assert(sizeof(Mesh::TriangleIndex) == 3 * sizeof(int), "TriangleIndex must be tightly packed");
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeSize;
+    uint64_t sourceHash;
+    uint64_t vNum, vtNum, vnNum;
+    uint64_t tNum, ttNum, tnNum;
+    uint64_t nodeNum, leafIdNum;
+};
+
+std::string cachePath(const char *objFile) {
+    return std::string(objFile) + ".pjcache";
+}
+
+template <typename T>
+bool readArray(const char *&p, const char *end, uint64_t num, std::vector<T> &out) {
+    if ((uint64_t) (end - p) / sizeof(T) < num) {
+        return false;
+    }
+    out.resize(num);
+    memcpy((void *) out.data(), p, num * sizeof(T));
+    p += num * sizeof(T);
+    return true;
+}
+
+// Indices of a triangle array into an array of num elements, -1 allowed
+// for the optional texture and normal indices.
+bool validIndices(const std::vector<Mesh::TriangleIndex> &t, uint64_t num, bool optional) {
+    for (Mesh::TriangleIndex index: t) {
+        for (int k = 0; k < 3; ++k) {
+            if (!(index[k] >= 0 && (uint64_t) index[k] < num) && !(optional && index[k] == -1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The nodes must form one tree in the pre-order flatten writes: children
+// after their parent and every node reached once, so restore terminates.
+// As KDTree::build makes them, a node is either a non-empty leaf or has
+// both children, which KDTree::intersect follows unchecked.
+bool validTree(const std::vector<KDTreeNode> &nodes, const std::vector<int> &leafIds, uint64_t tNum) {
+    for (int id: leafIds) {
+        if (id < 0 || (uint64_t) id >= tNum) {
+            return false;
+        }
+    }
+    std::vector<bool> reached(nodes.size(), false);
+    std::vector<int> stack(1, 0);
+    reached[0] = true;
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        const KDTreeNode &node = nodes[index];
+        if (node.dim < 0 || node.dim > 2 || node.leafBegin < 0 || node.leafSize < 0
+         || (uint64_t) node.leafBegin + node.leafSize > leafIds.size()) {
+            return false;
+        }
+        bool leaf = node.left == -1 && node.right == -1;
+        if (leaf != (node.leafSize > 0)) {
+            return false;
+        }
+        if (leaf) {
+            continue;
+        }
+        for (int child: {node.left, node.right}) {
+            if (child <= index || (size_t) child >= nodes.size() || reached[child]) {
+                return false;
+            }
+            reached[child] = true;
+            stack.push_back(child);
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void writeArray(FILE *file, const std::vector<T> &data) {
+    fwrite(data.data(), sizeof(T), data.size(), file);
+}
+
+} // namespace
+
+uint64_t hashMeshSource(const char *data, size_t size) {
+    // FNV-1a over 64-bit words with a final avalanche.
+    uint64_t h = 14695981039346656037ULL ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * 1099511628211ULL;
+    }
+    for (; i < size; ++i) {
+        h = (h ^ (unsigned char) data[i]) * 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bool loadMeshCache(const char *objFile, uint64_t sourceHash, Mesh *mesh) {
+    MappedFile file(cachePath(objFile).c_str());
+    if (!file.isOpen() || file.size() < sizeof(CacheHeader)) {
+        return false;
+    }
+    CacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+     || header.version != CACHE_VERSION
+     || header.nodeSize != sizeof(KDTreeNode)
+     || header.sourceHash != sourceHash) {
+        return false;
+    }
+    const char *p = file.data() + sizeof(header), *end = file.data() + file.size();
+    std::vector<KDTreeNode> nodes;
+    std::vector<int> leafIds;
+    if (!readArray(p, end, header.vNum, mesh->v)
+     || !readArray(p, end, header.vtNum, mesh->vt)
+     || !readArray(p, end, header.vnNum, mesh->vn)
+     || !readArray(p, end, header.tNum, mesh->t)
+     || !readArray(p, end, header.ttNum, mesh->tt)
+     || !readArray(p, end, header.tnNum, mesh->tn)
+     || !readArray(p, end, header.nodeNum, nodes)
+     || !readArray(p, end, header.leafIdNum, leafIds)
+     || nodes.empty()
+     || !validIndices(mesh->t, header.vNum, false)
+     || !validIndices(mesh->tt, header.vtNum, true)
+     || !validIndices(mesh->tn, header.vnNum, true)
+     || !validTree(nodes, leafIds, header.tNum)) {
+        mesh->v.clear(); mesh->vt.clear(); mesh->vn.clear();
+        mesh->t.clear(); mesh->tt.clear(); mesh->tn.clear();
+        return false;
+    }
+    mesh->root = new KDTree(mesh);
+    mesh->root->restore(nodes.data(), 0, leafIds.data());
+    return true;
+}
+
+bool saveMeshCache(const char *objFile, uint64_t sourceHash, const Mesh *mesh) {
+    if (mesh->root == nullptr) {
+        return false;
+    }
+    std::vector<KDTreeNode> nodes;
+    std::vector<int> leafIds;
+    mesh->root->flatten(nodes, leafIds);
+
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.nodeSize = sizeof(KDTreeNode);
+    header.sourceHash = sourceHash;
+    header.vNum = mesh->v.size();
+    header.vtNum = mesh->vt.size();
+    header.vnNum = mesh->vn.size();
+    header.tNum = mesh->t.size();
+    header.ttNum = mesh->tt.size();
+    header.tnNum = mesh->tn.size();
+    header.nodeNum = nodes.size();
+    header.leafIdNum = leafIds.size();
+
+    // Write to a temporary file of our own so concurrent renders never map
+    // a half-written cache.
+    std::string path = cachePath(objFile), temp = path + ".XXXXXX";
+    int fd = mkstemp(&temp[0]);
+    if (fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644);
+    FILE *file = fdopen(fd, "wb");
+    if (file == nullptr) {
+        close(fd);
+        remove(temp.c_str());
+        return false;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    writeArray(file, mesh->v);
+    writeArray(file, mesh->vt);
+    writeArray(file, mesh->vn);
+    writeArray(file, mesh->t);
+    writeArray(file, mesh->tt);
+    writeArray(file, mesh->tn);
+    writeArray(file, nodes);
+    writeArray(file, leafIds);
+    bool ok = !ferror(file);
+    ok &= fclose(file) == 0;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#include "photon_kdtree.hpp"
+#include <algorithm>
+
+PhotonKDTree::PhotonKDTree() {
+    rootDim = 0;
+}
+
+PhotonKDTree::~PhotonKDTree() = default;
+
+void PhotonKDTree::build(std::vector<Photon>::iterator begin, std::vector<Photon>::iterator end, int splitDim) {
+    // an empty map collects nothing
+    rootDim = splitDim;
+    split(begin, end, splitDim);
+    nodes.resize(end - begin);
+    for (int i = 0; i < (int) nodes.size(); ++i) {
+        encodePhoton(*(begin + i), nodes[i]);
+    }
+}
+
+void PhotonKDTree::split(std::vector<Photon>::iterator begin, std::vector<Photon>::iterator end, int splitDim) {
+    int length = end - begin;
+    if (length <= 1) {
+        return;
+    }
+    int mid = length / 2;
+    cmpPhoton func(splitDim);
+    std::nth_element(begin, begin + mid, end, func);
+    split(begin, begin + mid, (splitDim + 1) % 3);
+    split(begin + mid + 1, end, (splitDim + 1) % 3);
+}
+
+void PhotonKDTree::collect(Vector3f p, float r, std::vector<Photon> &data, const Vector3f &normal) {
+    collect(p, r * r, normal, 0, (int) nodes.size(), rootDim, data);
+}
+
+void PhotonKDTree::collect(const Vector3f &p, float r2, const Vector3f &normal, int begin, int end, int splitDim,
+                           std::vector<Photon> &data) const {
+    bool filter = normal != Vector3f::ZERO;
+    while (begin < end) {
+        int mid = begin + (end - begin) / 2;
+        const StoredPhoton &node = nodes[mid];
+        if ((p - node.pos).squaredLength() <= r2) {
+            Vector3f n = filter ? photonNormal(node) : Vector3f::ZERO;
+            if (n == Vector3f::ZERO || Vector3f::dot(n, normal) >= PHOTON_NORMAL_COS) {
+                data.emplace_back(decodePhoton(node));
+            }
+        }
+        // Descend into the side of p and visit the other only if the
+        // sphere crosses the split plane.
+        float d = p[splitDim] - node.pos[splitDim];
+        int nextDim = (splitDim + 1) % 3;
+        if (d < 0) {
+            if (d * d <= r2) {
+                collect(p, r2, normal, mid + 1, end, nextDim, data);
+            }
+            end = mid;
+        }
+        else {
+            if (d * d <= r2) {
+                collect(p, r2, normal, begin, mid, nextDim, data);
+            }
+            begin = mid + 1;
+        }
+        splitDim = nextDim;
+    }
+}
@@ -0,0 +1,190 @@
+#include "ppm.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+void ppmBackward(Object3D *o, Camera *camera, int spp, std::vector<std::vector<viewPoint>> &imgView) {
+    ScopedPhase phase(PHASE_HIT_POINTS);
+    imgView.resize(camera->getWidth() * camera->getHeight());
+    for (int x = 0; x < camera->getWidth(); ++x) {
+        std::cout << "Line " << x << std::endl;
+        #pragma omp parallel for schedule(dynamic, 128), num_threads(8)
+        for (int y = 0; y < camera->getHeight(); ++y) {
+            std::vector<Trace> trace;
+            std::vector<viewPoint> view;
+            for (int sppId = 0; sppId < spp; ++sppId) {
+                Ray r = camera->generateRay(Vector2f(x, y));
+                traceRay(o, r, Vector3f(1.0 / spp), 5, trace, false);
+            }
+            for (Trace &t: trace) {
+                viewPoint point;
+                point.trace = t;
+                point.shade = t.material->prepareShade(t.photon.dir, t.photon.normal, t.photon.power);
+                point.estimate = PhotonEstimate(0, PPM_ALPHA, PPM_RADIUS);
+                view.push_back(point);
+            }
+            imgView[x * camera->getHeight() + y] = view;
+        }
+    }
+}
+
+std::vector<int> lightPhotonCounts(const std::vector<Light*> &lights, int rayNum) {
+    int lightNum = (int) lights.size();
+    std::vector<int> counts(lightNum, 0);
+    std::vector<double> cdf(lightNum + 1, 0);
+    for (int li = 0; li < lightNum; ++li) {
+        Vector3f power = lights[li]->getPower();
+        cdf[li + 1] = cdf[li] + std::max(0.0f, (power[0] + power[1] + power[2]) / 3);
+    }
+    if (cdf[lightNum] <= 0) {
+        return counts;
+    }
+    int total = lightNum * rayNum, assigned = 0;
+    std::vector<std::pair<double, int>> remainders;
+    for (int li = 0; li < lightNum; ++li) {
+        double share = (cdf[li + 1] - cdf[li]) / cdf[lightNum] * total;
+        counts[li] = (int) share;
+        if (share > 0 && counts[li] == 0) {
+            counts[li] = 1;
+        }
+        assigned += counts[li];
+        remainders.emplace_back(share - (int) share, li);
+    }
+    std::sort(remainders.begin(), remainders.end(), std::greater<std::pair<double, int>>());
+    for (int i = 0; assigned < total && i < lightNum; ++i, ++assigned) {
+        ++counts[remainders[i].second];
+    }
+    return counts;
+}
+
+void ppmEmit(Object3D *o, std::vector<Light*> lights, int rayNum, std::vector<Photon> &photons, int depth,
+             PhotonMapType type, const EmissionGuide *guide) {
+    ScopedPhase phase(PHASE_PHOTON_EMIT);
+    std::vector<int> counts = lightPhotonCounts(lights, rayNum);
+    for (int li = 0; li < (int) lights.size(); ++li) {
+        Light *l = lights[li];
+        if (counts[li] == 0) {
+            continue;
+        }
+        float scale = (float) rayNum / counts[li];
+        #pragma omp parallel num_threads(8)
+        {
+            std::vector<Photon> threadPhotons;
+            std::vector<Trace> trace;
+            #pragma omp for schedule(dynamic, 60)
+            for (int rayId = 0; rayId < counts[li]; ++rayId) {
+                unsigned short cell = NO_EMISSION_CELL;
+                float weight = 1;
+                std::pair<Ray, Vector3f> generation = guide != nullptr && type != MAP_CAUSTIC
+                                                    ? guide->generate(l, li, cell, weight) : l->generate();
+                Ray r = generation.first;
+                weight *= scale;
+                Vector3f col = generation.second * weight;
+                if (type != MAP_CAUSTIC) {
+                    Photon origin;
+                    origin.pos = r.getOrigin();
+                    origin.dir = -r.getDirection();
+                    origin.power = col * 10;
+                    origin.normal = Vector3f::ZERO;
+                    origin.weight = weight;
+                    origin.cell = cell;
+                    threadPhotons.push_back(origin);
+                }
+                // Caustic paths end at their first diffuse hit.
+                trace.clear();
+                traceRay(o, r, col, depth, trace, type != MAP_CAUSTIC);
+                for (Trace &t: trace) {
+                    if (type == MAP_ALL || t.caustic == (type == MAP_CAUSTIC)) {
+                        t.photon.weight = weight;
+                        t.photon.cell = cell;
+                        threadPhotons.push_back(t.photon);
+                    }
+                }
+            }
+            PJ_COUNT_ADD(COUNTER_PHOTONS_STORED, threadPhotons.size());
+            #pragma omp critical
+            photons.insert(photons.end(), threadPhotons.begin(), threadPhotons.end());
+        }
+    }
+    std::cout << photons.size() << (type == MAP_CAUSTIC ? " caustic" : type == MAP_GLOBAL ? " global" : "")
+              << " photons in total." << std::endl;
+}
+
+void ppmGather(PhotonKDTree *root, std::vector<std::vector<viewPoint>> &imgView,
+               PhotonKDTree *causticRoot, float causticWeight, EmissionGuide *guide) {
+    ScopedPhase phase(PHASE_GATHER);
+    int logStep = std::max(1, (int) imgView.size() / 100);
+    #pragma omp parallel num_threads(8)
+    {
+        // gathered photon weights per emission cell
+        std::vector<float> gathered(guide != nullptr ? guide->getCellNum() : 0, 0);
+        std::vector<Photon> photon;
+        #pragma omp for schedule(dynamic, 128)
+        for (int viewId = 0; viewId < (int) imgView.size(); ++viewId) {
+            if (viewId % logStep == 0) {
+                std::cout << "View " << viewId << std::endl;
+            }
+            for (viewPoint &point: imgView[viewId]) {
+                PhotonEstimate &estimate = point.estimate;
+                Vector3f addPower = Vector3f::ZERO;
+                float addNum = 0;
+                for (int map = 0; map < (causticRoot != nullptr ? 2 : 1); ++map) {
+                    float weight = map == 1 ? causticWeight : 1;
+                    photon.clear();
+                    (map == 1 ? causticRoot : root)->collect(point.trace.photon.pos, estimate.radius, photon,
+                                                             point.trace.photon.normal);
+                    int m = (int) photon.size();
+                    PJ_COUNT_ADD(COUNTER_PHOTONS_GATHERED, m);
+                    addPower += weight * point.shade.gather(photon.data(), m);
+                    for (Photon &p: photon) {
+                        addNum += weight * p.weight;
+                        if (p.cell < gathered.size()) {
+                            gathered[p.cell] += p.weight;
+                        }
+                    }
+                }
+                estimate.update(addPower, addNum);
+            }
+        }
+        if (guide != nullptr) {
+            #pragma omp critical
+            guide->record(gathered);
+        }
+    }
+}
+
+void ppmForward(Object3D *o, std::vector<Light*> lights, int rayNum, int causticNum,
+                std::vector<std::vector<std::vector<viewPoint>>> &views, EmissionGuide *guide) {
+    std::vector<Photon> photons, causticPhotons;
+    ppmEmit(o, lights, rayNum, photons, 5, causticNum > 0 ? MAP_GLOBAL : MAP_ALL, guide);
+    if (causticNum > 0) {
+        ppmEmit(o, lights, causticNum, causticPhotons, 5, MAP_CAUSTIC);
+    }
+    PhotonKDTree *root = new PhotonKDTree, *causticRoot = nullptr;
+    {
+        ScopedPhase phase(PHASE_PHOTON_MAP);
+        root->build(photons.begin(), photons.end(), 0);
+        if (causticNum > 0) {
+            causticRoot = new PhotonKDTree;
+            causticRoot->build(causticPhotons.begin(), causticPhotons.end(), 0);
+        }
+    }
+    // A caustic photon stands for rayNum / causticNum photons of one map.
+    float causticWeight = causticNum > 0 ? (float) rayNum / causticNum : 1;
+    for (std::vector<std::vector<viewPoint>> &imgView: views) {
+        ppmGather(root, imgView, causticRoot, causticWeight, guide);
+    }
+    delete root;
+    delete causticRoot;
+}
+
+Vector3f getRadiance(const std::vector<viewPoint> &view) {
+    Vector3f radiance = Vector3f::ZERO;
+    for (const viewPoint &point: view) {
+        radiance += point.radiance();
+    }
+    return radiance;
+}
@@ -0,0 +1,161 @@
+#include "profiler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+PhaseTime phaseTimes[PHASE_COUNT];
+ScopedPhase *currentPhase = nullptr;
+
+const char *phaseNames[PHASE_COUNT] = {
+    "parse",
+    "accel_build",
+    "hit_points",
+    "photon_emit",
+    "photon_map",
+    "gather",
+    "resolve"
+};
+
+const char *counterNames[COUNTER_COUNT] = {
+    "rays",
+    "box_tests",
+    "triangle_tests",
+    "photons_stored",
+    "photons_gathered",
+    "newton_iterations"
+};
+
+// One cache line per thread so that counting does not false share.
+struct alignas(64) CounterSlots {
+    long long value[COUNTER_COUNT];
+};
+
+std::mutex counterMutex;
+std::vector<CounterSlots *> counterSlots;
+
+struct TraceEvent {
+    Phase phase;
+    double begin, duration;
+};
+
+bool tracing = false;
+double traceStart;
+std::vector<TraceEvent> traceEvents;
+
+} // namespace
+
+const char *phaseName(Phase phase) {
+    return phaseNames[phase];
+}
+
+const PhaseTime &getPhaseTime(Phase phase) {
+    return phaseTimes[phase];
+}
+
+void resetPhaseTimes() {
+    for (PhaseTime &time: phaseTimes) {
+        time.wall = time.cpu = 0;
+        time.calls = 0;
+    }
+}
+
+const char *counterName(Counter counter) {
+    return counterNames[counter];
+}
+
+long long getCounter(Counter counter) {
+    std::lock_guard<std::mutex> lock(counterMutex);
+    long long sum = 0;
+    for (CounterSlots *slots: counterSlots) {
+        sum += slots->value[counter];
+    }
+    return sum;
+}
+
+void resetCounters() {
+    std::lock_guard<std::mutex> lock(counterMutex);
+    for (CounterSlots *slots: counterSlots) {
+        for (long long &value: slots->value) {
+            value = 0;
+        }
+    }
+}
+
+long long *registerCounterSlots() {
+    // Slots outlive their thread so that the counts survive the thread pool.
+    // C++11 new ignores alignas beyond the default alignment.
+    void *memory = nullptr;
+    if (posix_memalign(&memory, alignof(CounterSlots), sizeof(CounterSlots)) != 0) {
+        printf("Cannot allocate profiler counters\n");
+        exit(1);
+    }
+    CounterSlots *slots = new (memory) CounterSlots();
+    std::lock_guard<std::mutex> lock(counterMutex);
+    counterSlots.push_back(slots);
+    return slots->value;
+}
+
+void startTrace() {
+    tracing = true;
+    traceStart = wallSeconds();
+    traceEvents.clear();
+}
+
+bool writeTrace(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "{\"traceEvents\": [\n");
+    for (int i = 0; i < (int) traceEvents.size(); ++i) {
+        const TraceEvent &event = traceEvents[i];
+        fprintf(file, "  {\"name\": \"%s\", \"cat\": \"phase\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": 1}%s\n",
+                phaseName(event.phase), event.begin * 1e6, event.duration * 1e6,
+                i + 1 < (int) traceEvents.size() ? "," : "");
+    }
+    fprintf(file, "],\n\"displayTimeUnit\": \"ms\"}\n");
+    fclose(file);
+    return true;
+}
+
+double wallSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double cpuSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+ScopedPhase::ScopedPhase(Phase phase) : phase(phase) {
+    parent = currentPhase;
+    currentPhase = this;
+    childWall = childCpu = 0;
+    wallStart = wallSeconds();
+    cpuStart = cpuSeconds();
+}
+
+ScopedPhase::~ScopedPhase() {
+    double wall = wallSeconds() - wallStart;
+    double cpu = cpuSeconds() - cpuStart;
+    PhaseTime &time = phaseTimes[phase];
+    time.wall += wall - childWall;
+    time.cpu += cpu - childCpu;
+    ++time.calls;
+    if (tracing) {
+        traceEvents.push_back(TraceEvent{phase, wallStart - traceStart, wall});
+    }
+    if (parent != nullptr) {
+        parent->childWall += wall;
+        parent->childCpu += cpu;
+    }
+    currentPhase = parent;
+}
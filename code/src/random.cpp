@@ -0,0 +1,44 @@
+#include "random.hpp"
+
+#include <atomic>
+#include <random>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+std::atomic<unsigned int> randomSeed(1);
+// Bumped by seedRandom so that every thread picks up the new seed.
+std::atomic<unsigned int> seedGeneration(1);
+
+struct ThreadRandom {
+    unsigned int generation = 0;
+    std::mt19937 engine;
+};
+
+thread_local ThreadRandom threadRandom;
+
+} // namespace
+
+void seedRandom(unsigned int seed) {
+    randomSeed = seed;
+    ++seedGeneration;
+}
+
+float random01() {
+    ThreadRandom &state = threadRandom;
+    unsigned int generation = seedGeneration;
+    if (state.generation != generation) {
+#ifdef _OPENMP
+        unsigned int thread = omp_get_thread_num();
+#else
+        unsigned int thread = 0;
+#endif
+        std::seed_seq seq{randomSeed.load(), thread};
+        state.engine.seed(seq);
+        state.generation = generation;
+    }
+    // 24 random bits, exactly representable and below 1
+    return (state.engine() >> 8) * (1.0f / 16777216);
+}
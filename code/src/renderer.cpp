@@ -0,0 +1,121 @@
+#include "renderer.hpp"
+#include "group.hpp"
+#include "profiler.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool parseRenderEngine(const char *name, RenderEngine &engine) {
+    if (!strcmp(name, "ppm")) {
+        engine = ENGINE_PPM;
+    } else if (!strcmp(name, "sppm")) {
+        engine = ENGINE_SPPM;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Renderer::Renderer() {
+    scene = nullptr;
+    passes = 0;
+}
+
+Renderer::~Renderer() {
+    for (Image *framebuffer: framebuffers) {
+        delete framebuffer;
+    }
+    delete scene;
+}
+
+void Renderer::loadScene(const char *filename) {
+    for (Image *framebuffer: framebuffers) {
+        delete framebuffer;
+    }
+    framebuffers.clear();
+    delete scene;
+    {
+        ScopedPhase phase(PHASE_PARSE);
+        scene = new SceneParser(filename);
+    }
+    lights.clear();
+    for (int li = 0; li < scene->getNumLights(); ++li) {
+        lights.push_back(scene->getLight(li));
+    }
+    if (scene->getNumCameras() == 0) {
+        printf("no camera specified\n");
+        exit(0);
+    }
+    if (scene->getGroup() == nullptr) {
+        printf("no group specified\n");
+        exit(0);
+    }
+    cameras.clear();
+    for (int cameraId = 0; cameraId < scene->getNumCameras(); ++cameraId) {
+        Camera *camera = scene->getCamera(cameraId);
+        cameras.push_back(camera);
+        framebuffers.push_back(new Image(camera->getWidth(), camera->getHeight()));
+    }
+    reset();
+}
+
+void Renderer::configure(const RenderSettings &settings) {
+    this->settings = settings;
+    reset();
+}
+
+void Renderer::reset() {
+    passes = 0;
+    ppmViews.clear();
+    sppmViews.clear();
+    guide.reset((int) lights.size());
+    resolved.assign(framebuffers.size(), false);
+    for (Image *framebuffer: framebuffers) {
+        framebuffer->SetAllPixels(Vector3f::ZERO);
+    }
+}
+
+void Renderer::renderPass() {
+    assert(scene != nullptr);
+    Group *group = scene->getGroup();
+    EmissionGuide *passGuide = settings.guided ? &guide : nullptr;
+    if (settings.engine == ENGINE_PPM) {
+        if (ppmViews.empty()) {
+            ppmViews.resize(cameras.size());
+            for (int cameraId = 0; cameraId < (int) cameras.size(); ++cameraId) {
+                ppmBackward(group, cameras[cameraId], settings.spp, ppmViews[cameraId]);
+            }
+        }
+        ppmForward(group, lights, settings.photons, settings.causticPhotons, ppmViews, passGuide);
+    } else {
+        sppmPass(group, lights, settings.photons, settings.causticPhotons, cameras, settings.spp, sppmViews, passGuide);
+    }
+    if (passGuide != nullptr) {
+        passGuide->update();
+    }
+    ++passes;
+    resolved.assign(framebuffers.size(), false);
+}
+
+const Image &Renderer::getFramebuffer(int cameraId) {
+    assert(scene != nullptr && cameraId >= 0 && cameraId < (int) cameras.size());
+    Image *framebuffer = framebuffers[cameraId];
+    if (!resolved[cameraId] && passes > 0) {
+        ScopedPhase phase(PHASE_RESOLVE);
+        Camera *camera = cameras[cameraId];
+        for (int x = 0; x < camera->getWidth(); ++x) {
+            for (int y = 0; y < camera->getHeight(); ++y) {
+                int offset = x * camera->getHeight() + y;
+                if (settings.engine == ENGINE_PPM) {
+                    framebuffer->SetPixel(x, y, getRadiance(ppmViews[cameraId][offset]));
+                } else {
+                    framebuffer->SetPixel(x, y, sppmViews[cameraId][offset].radiance());
+                }
+            }
+        }
+    }
+    resolved[cameraId] = true;
+    return *framebuffer;
+}
@@ -2,8 +2,13 @@
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include <cctype>
+#include <cstdarg>
+#include <unistd.h>
 
 #include "scene_parser.hpp"
+#include "mapped_file.hpp"
+#include "number_parser.hpp"
 #include "camera.hpp"
 #include "light.hpp"
 #include "material.hpp"
@@ -23,35 +28,48 @@
 
 #define DegreesToRadians(x) ((M_PI * x) / 180.0f)
 
+// Scene text is read whole and tokenized in memory.  Sources form a
+// stack so that "#include <file>" can splice another scene file in at
+// any token position.
+struct SceneParser::SceneSource {
+    explicit SceneSource(const char *filename) : file(filename), path(filename) {
+        p = file.data();
+        end = file.data() + file.size();
+        line = column = 1;
+    }
+    MappedFile file;
+    std::string path;
+    const char *p, *end;
+    int line, column;
+};
+
 SceneParser::SceneParser(const char *filename) {
 
     // initialize some reasonable default values
     group = nullptr;
-    camera = nullptr;
     background_color = Vector3f(0.5, 0.5, 0.5);
     num_lights = 0;
     lights = nullptr;
     num_materials = 0;
     materials = nullptr;
     current_material = nullptr;
+    transformDepth = 0;
 
     // parse the file
     assert(filename != nullptr);
-    const char *ext = &filename[strlen(filename) - 4];
+    size_t length = strlen(filename);
 
-    if (strcmp(ext, ".txt") != 0) {
+    if (length < 4 || strcmp(filename + length - 4, ".txt") != 0) {
         printf("wrong file name extension\n");
         exit(0);
     }
-    file = fopen(filename, "r");
-
-    if (file == nullptr) {
-        printf("cannot open scene file\n");
+    tokenFile = filename;
+    tokenLine = tokenColumn = 0;
+    if (!pushSource(filename)) {
+        printf("cannot open scene file %s\n", filename);
         exit(0);
     }
     parseFile();
-    fclose(file);
-    file = nullptr;
 
     if (num_lights == 0) {
         printf("WARNING:    No lights specified\n");
@@ -60,8 +78,13 @@ SceneParser::SceneParser(const char *filename) {
 
 SceneParser::~SceneParser() {
 
+    for (SceneSource *source: sources) {
+        delete source;
+    }
     delete group;
-    delete camera;
+    for (Camera *camera: cameras) {
+        delete camera;
+    }
 
     int i;
     for (i = 0; i < num_materials; i++) {
@@ -72,6 +95,10 @@ SceneParser::~SceneParser() {
         delete lights[i];
     }
     delete[] lights;
+    // after the group, which holds the instances
+    for (auto &mesh: meshes) {
+        delete mesh.second;
+    }
 }
 
 // ====================================================================
@@ -79,7 +106,7 @@ SceneParser::~SceneParser() {
 
 void SceneParser::parseFile() {
     //
-    // at the top level, the scene can have a camera, 
+    // at the top level, the scene can have cameras, 
     // background color and a group of objects
     // (we add lights and other things in future assignments)
     //
@@ -98,8 +125,7 @@ void SceneParser::parseFile() {
         } else if (!strcmp(token, "Group")) {
             group = parseGroup();
         } else {
-            printf("Unknown token in parseFile: '%s'\n", token);
-            exit(0);
+            parseError("unknown token '%s' at top level", token);
         }
     }
 }
@@ -108,83 +134,61 @@ void SceneParser::parseFile() {
 // ====================================================================
 
 void SceneParser::parsePerspectiveCamera() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
     // read in the camera parameters
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "center"));
+    expectToken("{");
+    expectToken("center");
     Vector3f center = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "direction"));
+    expectToken("direction");
     Vector3f direction = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "up"));
+    expectToken("up");
     Vector3f up = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "angle"));
+    expectToken("angle");
     float angle_degrees = readFloat();
     float angle_radians = DegreesToRadians(angle_degrees);
-    getToken(token);
-    assert (!strcmp(token, "width"));
+    expectToken("width");
     int width = readInt();
-    getToken(token);
-    assert (!strcmp(token, "height"));
+    expectToken("height");
     int height = readInt();
-    getToken(token);
-    assert (!strcmp(token, "}"));
-    camera = new PerspectiveCamera(center, direction, up, width, height, angle_radians);
+    expectToken("}");
+    cameras.push_back(new PerspectiveCamera(center, direction, up, width, height, angle_radians));
 }
 
 void SceneParser::parseLensCamera() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
     // read in the camera parameters
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "center"));
+    expectToken("{");
+    expectToken("center");
     Vector3f center = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "direction"));
+    expectToken("direction");
     Vector3f direction = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "up"));
+    expectToken("up");
     Vector3f up = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "angle"));
+    expectToken("angle");
     float angle_degrees = readFloat();
     float angle_radians = DegreesToRadians(angle_degrees);
-    getToken(token);
-    assert (!strcmp(token, "width"));
+    expectToken("width");
     int width = readInt();
-    getToken(token);
-    assert (!strcmp(token, "height"));
+    expectToken("height");
     int height = readInt();
-    getToken(token);
-    assert (!strcmp(token, "radius"));
+    expectToken("radius");
     float radius = readFloat();
-    getToken(token);
-    assert (!strcmp(token, "depth"));
+    expectToken("depth");
     float depth = readFloat();
-    getToken(token);
-    assert (!strcmp(token, "}"));
-    camera = new LensCamera(center, direction, up, width, height, angle_radians, radius, depth);
+    expectToken("}");
+    cameras.push_back(new LensCamera(center, direction, up, width, height, angle_radians, radius, depth));
 }
 
 void SceneParser::parseBackground() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     // read in the background color
-    getToken(token);
-    assert (!strcmp(token, "{"));
+    expectToken("{");
     while (true) {
-        getToken(token);
+        nextToken(token);
         if (!strcmp(token, "}")) {
             break;
         } else if (!strcmp(token, "color")) {
             background_color = readVector3f();
         } else {
-            printf("Unknown token in parseBackground: '%s'\n", token);
-            assert(0);
+            parseError("unknown token '%s' in Background", token);
         }
     }
 }
@@ -194,17 +198,15 @@ void SceneParser::parseBackground() {
 
 void SceneParser::parseLights() {
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
+    expectToken("{");
     // read in the number of objects
-    getToken(token);
-    assert (!strcmp(token, "numLights"));
-    num_lights = readInt();
+    expectToken("numLights");
+    num_lights = readCount();
     lights = new Light *[num_lights];
     // read in the objects
     int count = 0;
     while (num_lights > count) {
-        getToken(token);
+        nextToken(token);
         if (strcmp(token, "DirectionalLight") == 0) {
             lights[count] = parseDirectionalLight();
         } else if (strcmp(token, "PointLight") == 0) {
@@ -212,72 +214,50 @@ void SceneParser::parseLights() {
         } else if (strcmp(token, "AreaLight") == 0) {
             lights[count] = parseAreaLight();
         } else {
-            printf("Unknown token in parseLight: '%s'\n", token);
-            exit(0);
+            parseError("unknown light type '%s'", token);
         }
         count++;
     }
-    getToken(token);
-    assert (!strcmp(token, "}"));
+    expectToken("}");
 }
 
 Light *SceneParser::parseDirectionalLight() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "direction"));
+    expectToken("{");
+    expectToken("direction");
     Vector3f direction = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "color"));
+    expectToken("color");
     Vector3f color = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "}"));
+    expectToken("}");
     return new DirectionalLight(direction, color);
 }
 
 Light *SceneParser::parsePointLight() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "position"));
+    expectToken("{");
+    expectToken("position");
     Vector3f position = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "color"));
+    expectToken("color");
     Vector3f color = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "}"));
+    expectToken("}");
     return new PointLight(position, color);
 }
 
 Light *SceneParser::parseAreaLight() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "center"));
+    expectToken("{");
+    expectToken("center");
     Vector3f center = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "z"));
+    expectToken("z");
     Vector3f z = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "x"));
+    expectToken("x");
     Vector3f x = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "y"));
+    expectToken("y");
     Vector3f y = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "wx"));
+    expectToken("wx");
     float wx = readFloat();
-    getToken(token);
-    assert (!strcmp(token, "wy"));
+    expectToken("wy");
     float wy = readFloat();
-    getToken(token);
-    assert (!strcmp(token, "color"));
+    expectToken("color");
     Vector3f color = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "}"));
+    expectToken("}");
     return new AreaLight(center, z, x, y, wx, wy, color);
 }
 // ====================================================================
@@ -285,28 +265,24 @@ Light *SceneParser::parseAreaLight() {
 
 void SceneParser::parseMaterials() {
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
+    expectToken("{");
     // read in the number of objects
-    getToken(token);
-    assert (!strcmp(token, "numMaterials"));
-    num_materials = readInt();
+    expectToken("numMaterials");
+    num_materials = readCount();
     materials = new Material *[num_materials];
     // read in the objects
     int count = 0;
     while (num_materials > count) {
-        getToken(token);
+        nextToken(token);
         if (!strcmp(token, "Material") ||
             !strcmp(token, "PhongMaterial")) {
             materials[count] = parseMaterial();
         } else {
-            printf("Unknown token in parseMaterial: '%s'\n", token);
-            exit(0);
+            parseError("unknown material type '%s'", token);
         }
         count++;
     }
-    getToken(token);
-    assert (!strcmp(token, "}"));
+    expectToken("}");
 }
 
 
@@ -318,10 +294,9 @@ Material *SceneParser::parseMaterial() {
     float shininess = 0;
     float specularRatio = 0;
     float refraction = 1;
-    getToken(token);
-    assert (!strcmp(token, "{"));
+    expectToken("{");
     while (true) {
-        getToken(token);
+        nextToken(token);
         if (strcmp(token, "diffuseColor") == 0) {
             diffuseColor = readVector3f();
         } else if (strcmp(token, "specularColor") == 0) {
@@ -334,10 +309,11 @@ Material *SceneParser::parseMaterial() {
             refraction = readFloat();
         } else if (strcmp(token, "texture") == 0) {
             // Optional: read in texture and draw it.
-            getToken(filename);
-        } else {
-            assert (!strcmp(token, "}"));
+            nextToken(filename);
+        } else if (strcmp(token, "}") == 0) {
             break;
+        } else {
+            parseError("unknown token '%s' in Material", token);
         }
     }
     auto *answer = new Material(diffuseColor, specularColor, shininess, specularRatio, refraction);
@@ -368,8 +344,7 @@ Object3D *SceneParser::parseObject(char token[MAX_PARSER_TOKEN_LENGTH]) {
     } else if (!strcmp(token, "RevSurface")) {
         answer = (Object3D *) parseRevSurface();
     } else {
-        printf("Unknown token in parseObject: '%s'\n", token);
-        exit(0);
+        parseError("unknown object type '%s'", token);
     }
     return answer;
 }
@@ -387,35 +362,33 @@ Group *SceneParser::parseGroup() {
     // simple, and essentially ignores any tree hierarchy)
     //
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
+    expectToken("{");
 
     // read in the number of objects
-    getToken(token);
-    assert (!strcmp(token, "numObjects"));
-    int num_objects = readInt();
+    expectToken("numObjects");
+    int num_objects = readCount();
 
     auto *answer = new Group(num_objects);
 
     // read in the objects
     int count = 0;
     while (num_objects > count) {
-        getToken(token);
+        nextToken(token);
         if (!strcmp(token, "MaterialIndex")) {
             // change the current material
             int index = readInt();
-            assert (index >= 0 && index <= getNumMaterials());
+            if (index < 0 || index >= getNumMaterials()) {
+                parseError("material index %d out of range [0, %d)", index, getNumMaterials());
+            }
             current_material = getMaterial(index);
         } else {
             Object3D *object = parseObject(token);
-            assert (object != nullptr);
             answer->addObject(count, object);
 
             count++;
         }
     }
-    getToken(token);
-    assert (!strcmp(token, "}"));
+    expectToken("}");
 
     // return the group
     return answer;
@@ -425,94 +398,85 @@ Group *SceneParser::parseGroup() {
 // ====================================================================
 
 Sphere *SceneParser::parseSphere() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "center"));
+    expectToken("{");
+    expectToken("center");
     Vector3f center = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "radius"));
+    expectToken("radius");
     float radius = readFloat();
-    getToken(token);
-    assert (!strcmp(token, "}"));
-    assert (current_material != nullptr);
+    expectToken("}");
+    requireMaterial();
     return new Sphere(center, radius, current_material);
 }
 
 
 Plane *SceneParser::parsePlane() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "normal"));
+    expectToken("{");
+    expectToken("normal");
     Vector3f normal = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "offset"));
+    expectToken("offset");
     float offset = readFloat();
-    getToken(token);
-    assert (!strcmp(token, "}"));
-    assert (current_material != nullptr);
+    expectToken("}");
+    requireMaterial();
     return new Plane(normal, offset, current_material);
 }
 
 
 Triangle *SceneParser::parseTriangle() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "vertex0"));
+    expectToken("{");
+    expectToken("vertex0");
     Vector3f v0 = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "vertex1"));
+    expectToken("vertex1");
     Vector3f v1 = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "vertex2"));
+    expectToken("vertex2");
     Vector3f v2 = readVector3f();
-    getToken(token);
-    assert (!strcmp(token, "}"));
-    assert (current_material != nullptr);
+    expectToken("}");
+    requireMaterial();
     return new Triangle(v0, v1, v2, current_material);
 }
 
-Mesh *SceneParser::parseTriangleMesh() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
+Object3D *SceneParser::parseTriangleMesh() {
     char filename[MAX_PARSER_TOKEN_LENGTH];
     // get the filename
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "obj_file"));
-    getToken(filename);
-    getToken(token);
-    assert (!strcmp(token, "}"));
-    const char *ext = &filename[strlen(filename) - 4];
-    assert(!strcmp(ext, ".obj"));
-    Mesh *answer = new Mesh(filename, current_material);
-
-    return answer;
+    expectToken("{");
+    expectToken("obj_file");
+    nextToken(filename);
+    size_t length = strlen(filename);
+    if (length < 4 || strcmp(filename + length - 4, ".obj") != 0) {
+        parseError("TriangleMesh expects an .obj file, found '%s'", filename);
+    }
+    // relative to the file naming it, like #include; scenes written for the
+    // working directory still load, with a warning
+    std::string path = resolvePath(filename);
+    if (access(path.c_str(), R_OK) != 0) {
+        if (access(filename, R_OK) != 0) {
+            parseError("cannot open obj_file '%s'", path.c_str());
+        }
+        fprintf(stderr, "%s:%d:%d: warning: obj_file '%s' is not next to the scene file, using it from the working directory\n",
+                tokenFile.c_str(), tokenLine, tokenColumn, filename);
+        path = filename;
+    }
+    expectToken("}");
+    Mesh *&mesh = meshes[path];
+    if (mesh == nullptr) {
+        mesh = new Mesh(path.c_str(), current_material);
+    }
+    return new MeshInstance(mesh, current_material);
 }
 
 Curve *SceneParser::parseBezierCurve() {
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "controls"));
+    expectToken("{");
+    expectToken("controls");
     vector<Vector3f> controls;
     while (true) {
-        getToken(token);
+        nextToken(token);
         if (!strcmp(token, "[")) {
             controls.push_back(readVector3f());
-            getToken(token);
-            assert (!strcmp(token, "]"));
+            expectToken("]");
         } else if (!strcmp(token, "}")) {
             break;
         } else {
-            printf("Incorrect format for BezierCurve!\n");
-            exit(0);
+            parseError("expected '[' or '}' in BezierCurve, found '%s'", token);
         }
     }
     Curve *answer = new BezierCurve(controls);
@@ -522,22 +486,18 @@ Curve *SceneParser::parseBezierCurve() {
 
 Curve *SceneParser::parseBsplineCurve() {
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "controls"));
+    expectToken("{");
+    expectToken("controls");
     vector<Vector3f> controls;
     while (true) {
-        getToken(token);
+        nextToken(token);
         if (!strcmp(token, "[")) {
             controls.push_back(readVector3f());
-            getToken(token);
-            assert (!strcmp(token, "]"));
+            expectToken("]");
         } else if (!strcmp(token, "}")) {
             break;
         } else {
-            printf("Incorrect format for BsplineCurve!\n");
-            exit(0);
+            parseError("expected '[' or '}' in BsplineCurve, found '%s'", token);
         }
     }
     Curve *answer = new BsplineCurve(controls);
@@ -546,23 +506,31 @@ Curve *SceneParser::parseBsplineCurve() {
 
 RevSurface *SceneParser::parseRevSurface() {
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert (!strcmp(token, "{"));
-    getToken(token);
-    assert (!strcmp(token, "profile"));
+    expectToken("{");
+    expectToken("profile");
     Curve* profile;
-    getToken(token);
+    nextToken(token);
     if (!strcmp(token, "BezierCurve")) {
         profile = parseBezierCurve();
     } else if (!strcmp(token, "BsplineCurve")) {
         profile = parseBsplineCurve();
     } else {
-        printf("Unknown profile type in parseRevSurface: '%s'\n", token);
-        exit(0);
+        parseError("unknown profile type '%s' in RevSurface", token);
+    }
+    // optional bound on the proxy mesh error
+    float tolerance = REV_TOLERANCE;
+    nextToken(token);
+    if (!strcmp(token, "tolerance")) {
+        tolerance = readFloat();
+        if (tolerance <= 0) {
+            parseError("RevSurface tolerance must be positive");
+        }
+        nextToken(token);
     }
-    getToken(token);
-    assert (!strcmp(token, "}"));
-    auto *answer = new RevSurface(profile, current_material);
+    if (strcmp(token, "}")) {
+        parseError("expected 'tolerance' or '}' in RevSurface, found '%s'", token);
+    }
+    auto *answer = new RevSurface(profile, current_material, tolerance);
     return answer;
 }
 
@@ -570,12 +538,14 @@ Transform *SceneParser::parseTransform() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     Matrix4f matrix = Matrix4f::identity();
     Object3D *object = nullptr;
-    getToken(token);
-    assert (!strcmp(token, "{"));
+    if (++transformDepth > Hit::MAX_TRANSFORMS) {
+        parseError("Transform nested deeper than %d levels", Hit::MAX_TRANSFORMS);
+    }
+    expectToken("{");
     // read in transformations: 
     // apply to the LEFT side of the current matrix (so the first
     // transform in the list is the last applied to the object)
-    getToken(token);
+    nextToken(token);
 
     while (true) {
         if (!strcmp(token, "Scale")) {
@@ -593,26 +563,22 @@ Transform *SceneParser::parseTransform() {
         } else if (!strcmp(token, "ZRotate")) {
             matrix = matrix * Matrix4f::rotateZ(DegreesToRadians(readFloat()));
         } else if (!strcmp(token, "Rotate")) {
-            getToken(token);
-            assert (!strcmp(token, "{"));
+            expectToken("{");
             Vector3f axis = readVector3f();
             float degrees = readFloat();
             float radians = DegreesToRadians(degrees);
             matrix = matrix * Matrix4f::rotation(axis, radians);
-            getToken(token);
-            assert (!strcmp(token, "}"));
+            expectToken("}");
         } else if (!strcmp(token, "Matrix4f")) {
             Matrix4f matrix2 = Matrix4f::identity();
-            getToken(token);
-            assert (!strcmp(token, "{"));
+            expectToken("{");
             for (int j = 0; j < 4; j++) {
                 for (int i = 0; i < 4; i++) {
                     float v = readFloat();
                     matrix2(i, j) = v;
                 }
             }
-            getToken(token);
-            assert (!strcmp(token, "}"));
+            expectToken("}");
             matrix = matrix2 * matrix;
         } else {
             // otherwise this must be an object,
@@ -620,58 +586,171 @@ Transform *SceneParser::parseTransform() {
             object = parseObject(token);
             break;
         }
-        getToken(token);
+        nextToken(token);
     }
 
-    assert(object != nullptr);
-    getToken(token);
-    assert (!strcmp(token, "}"));
+    expectToken("}");
+    --transformDepth;
     return new Transform(matrix, object);
 }
 
 // ====================================================================
 // ====================================================================
 
+bool SceneParser::pushSource(const char *filename) {
+    if (sources.size() >= MAX_INCLUDE_DEPTH) {
+        parseError("#include nested deeper than %d files", MAX_INCLUDE_DEPTH);
+    }
+    auto *source = new SceneSource(filename);
+    if (!source->file.isOpen()) {
+        delete source;
+        return false;
+    }
+    sources.push_back(source);
+    return true;
+}
+
+void SceneParser::parseError(const char *format, ...) {
+    fprintf(stderr, "%s:%d:%d: error: ", tokenFile.c_str(), tokenLine, tokenColumn);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+int SceneParser::readToken(char token[MAX_PARSER_TOKEN_LENGTH]) {
+    while (!sources.empty()) {
+        SceneSource &src = *sources.back();
+        while (src.p < src.end && isspace((unsigned char) *src.p)) {
+            if (*src.p == '\n') {
+                ++src.line;
+                src.column = 1;
+            }
+            else {
+                ++src.column;
+            }
+            ++src.p;
+        }
+        if (src.p == src.end) {
+            delete sources.back();
+            sources.pop_back();
+            continue;
+        }
+        tokenFile = src.path;
+        tokenLine = src.line;
+        tokenColumn = src.column;
+        // for simplicity, tokens must be separated by whitespace
+        const char *start = src.p;
+        while (src.p < src.end && !isspace((unsigned char) *src.p)) {
+            ++src.p;
+        }
+        size_t length = src.p - start;
+        src.column += (int) length;
+        if (length >= MAX_PARSER_TOKEN_LENGTH) {
+            parseError("token longer than %d characters", MAX_PARSER_TOKEN_LENGTH - 1);
+        }
+        memcpy(token, start, length);
+        token[length] = '\0';
+        return 1;
+    }
+    token[0] = '\0';
+    return 0;
+}
+
 int SceneParser::getToken(char token[MAX_PARSER_TOKEN_LENGTH]) {
-    // for simplicity, tokens must be separated by whitespace
-    assert (file != nullptr);
-    int success = fscanf(file, "%s ", token);
-    if (success == EOF) {
-        token[0] = '\0';
-        return 0;
+    while (readToken(token)) {
+        if (strcmp(token, "#include") != 0) {
+            return 1;
+        }
+        // the path may be quoted and is relative to the including file
+        char name[MAX_PARSER_TOKEN_LENGTH];
+        if (!readToken(name)) {
+            parseError("#include expects a file name");
+        }
+        std::string path = name;
+        if (path.size() >= 2 && path.front() == '"' && path.back() == '"') {
+            path = path.substr(1, path.size() - 2);
+        }
+        path = resolvePath(path);
+        if (!pushSource(path.c_str())) {
+            parseError("cannot open included file '%s'", path.c_str());
+        }
     }
-    return 1;
+    return 0;
 }
 
+std::string SceneParser::resolvePath(const std::string &name) const {
+    if (name.empty() || name[0] == '/') {
+        return name;
+    }
+    return tokenFile.substr(0, tokenFile.find_last_of('/') + 1) + name;
+}
 
-Vector3f SceneParser::readVector3f() {
-    float x, y, z;
-    int count = fscanf(file, "%f %f %f", &x, &y, &z);
-    if (count != 3) {
-        printf("Error trying to read 3 floats to make a Vector3f\n");
-        assert (0);
+void SceneParser::nextToken(char token[MAX_PARSER_TOKEN_LENGTH]) {
+    if (!getToken(token)) {
+        parseError("unexpected end of file");
+    }
+}
+
+void SceneParser::expectToken(const char *expected) {
+    char token[MAX_PARSER_TOKEN_LENGTH];
+    if (!getToken(token)) {
+        parseError("expected '%s' but reached end of file", expected);
+    }
+    if (strcmp(token, expected) != 0) {
+        parseError("expected '%s' but found '%s'", expected, token);
+    }
+}
+
+void SceneParser::requireMaterial() {
+    if (current_material == nullptr) {
+        parseError("object defined before any MaterialIndex");
     }
+}
+
+
+Vector3f SceneParser::readVector3f() {
+    float x = readFloat();
+    float y = readFloat();
+    float z = readFloat();
     return Vector3f(x, y, z);
 }
 
 
 float SceneParser::readFloat() {
+    char token[MAX_PARSER_TOKEN_LENGTH];
+    if (!getToken(token)) {
+        parseError("expected a number but reached end of file");
+    }
     float answer;
-    int count = fscanf(file, "%f", &answer);
-    if (count != 1) {
-        printf("Error trying to read 1 float\n");
-        assert (0);
+    const char *p = token, *end = token + strlen(token);
+    if (!parseFloat(p, end, answer) || p != end) {
+        parseError("expected a number but found '%s'", token);
     }
     return answer;
 }
 
 
 int SceneParser::readInt() {
+    char token[MAX_PARSER_TOKEN_LENGTH];
+    if (!getToken(token)) {
+        parseError("expected an integer but reached end of file");
+    }
     int answer;
-    int count = fscanf(file, "%d", &answer);
-    if (count != 1) {
-        printf("Error trying to read 1 int\n");
-        assert (0);
+    const char *p = token, *end = token + strlen(token);
+    if (!parseInt(p, end, answer) || p != end) {
+        parseError("expected an integer but found '%s'", token);
+    }
+    return answer;
+}
+
+
+int SceneParser::readCount() {
+    int answer = readInt();
+    if (answer < 0) {
+        parseError("expected a count but found %d", answer);
     }
     return answer;
 }
@@ -0,0 +1,88 @@
+#include "sppm.hpp"
+#include "ppm.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void sppmBackward(Object3D *o, Camera *camera, int spp, PhotonKDTree *root, PhotonKDTree *causticRoot,
+                  float causticWeight, std::vector<sppmPixel> &imgView, EmissionGuide *guide) {
+    // Hit points are traced and gathered in one sweep, timed as gather.
+    ScopedPhase phase(PHASE_GATHER);
+    int height = camera->getHeight();
+    int size = camera->getWidth() * height;
+    imgView.resize(size);
+    int logStep = std::max(1, size / 10);
+    #pragma omp parallel num_threads(8)
+    {
+    // gathered photon weights per emission cell
+    std::vector<float> gathered(guide != nullptr ? guide->getCellNum() : 0, 0);
+    #pragma omp for schedule(dynamic, 128)
+    for (int offset = 0; offset < size; ++offset) {
+        if (offset % logStep == 0) {
+            std::cout << "viewId " << offset << std::endl;
+        }
+        int x = offset / height, y = offset % height;
+        sppmPixel &pixel = imgView[offset];
+        // Photon counts are pooled over the spp paths of the pixel, so each
+        // path carries full weight and the pooled estimate is their average.
+        std::vector<Trace> trace;
+        for (int sppId = 0; sppId < spp; ++sppId) {
+            Ray r = camera->generateRay(Vector2f(x, y));
+            traceRay(o, r, Vector3f(1.0), 5, trace, false);
+        }
+        std::vector<Photon> collected;
+        PhotonEstimate &estimate = pixel.estimate;
+        float addNum = 0;
+        Vector3f addPower = Vector3f::ZERO;
+        for (Trace &t: trace) {
+            ShadeState shade = t.material->prepareShade(t.photon.dir, t.photon.normal, t.photon.power);
+            for (int map = 0; map < (causticRoot != nullptr ? 2 : 1); ++map) {
+                float weight = map == 1 ? causticWeight : 1;
+                collected.clear();
+                (map == 1 ? causticRoot : root)->collect(t.photon.pos, estimate.radius, collected, t.photon.normal);
+                PJ_COUNT_ADD(COUNTER_PHOTONS_GATHERED, collected.size());
+                addPower += weight * shade.gather(collected.data(), (int) collected.size());
+                for (Photon &p: collected) {
+                    addNum += weight * p.weight;
+                    if (p.cell < gathered.size()) {
+                        gathered[p.cell] += p.weight;
+                    }
+                }
+            }
+        }
+        estimate.update(addPower, addNum);
+    }
+    if (guide != nullptr) {
+        #pragma omp critical
+        guide->record(gathered);
+    }
+    }
+}
+
+void sppmPass(Object3D *o, std::vector<Light*> lights, int rayNum, int causticNum,
+              const std::vector<Camera*> &cameras, int spp, std::vector<std::vector<sppmPixel>> &views,
+              EmissionGuide *guide) {
+    std::vector<Photon> photons, causticPhotons;
+    ppmEmit(o, lights, rayNum, photons, SPPM_PHOTON_DEPTH, causticNum > 0 ? MAP_GLOBAL : MAP_ALL, guide);
+    if (causticNum > 0) {
+        ppmEmit(o, lights, causticNum, causticPhotons, SPPM_PHOTON_DEPTH, MAP_CAUSTIC);
+    }
+    PhotonKDTree *root = new PhotonKDTree, *causticRoot = nullptr;
+    {
+        ScopedPhase phase(PHASE_PHOTON_MAP);
+        root->build(photons.begin(), photons.end(), 0);
+        if (causticNum > 0) {
+            causticRoot = new PhotonKDTree;
+            causticRoot->build(causticPhotons.begin(), causticPhotons.end(), 0);
+        }
+    }
+    views.resize(cameras.size());
+    float causticWeight = causticNum > 0 ? (float) rayNum / causticNum : 1;
+    for (int cameraId = 0; cameraId < (int) cameras.size(); ++cameraId) {
+        sppmBackward(o, cameras[cameraId], spp, root, causticRoot, causticWeight, views[cameraId], guide);
+    }
+    delete root;
+    delete causticRoot;
+}
@@ -0,0 +1,87 @@
+#include "tracer.hpp"
+#include "profiler.hpp"
+#include "random.hpp"
+
+#include <cmath>
+
+float minTime = 1e-2;
+float minPower = 1e-5;
+
+Vector3f randomDiffuse(const Vector3f &normal) {
+    Vector3f dir;
+    do {
+        dir[0] = 2 * random01() - 1;
+        dir[1] = 2 * random01() - 1;
+        dir[2] = 2 * random01() - 1;
+    } while (dir.squaredLength() > 1 || Vector3f::dot(dir, normal) <= 0);
+    return dir.normalized();
+}
+
+void traceRay(Object3D *o, const Ray &r, const Vector3f &power, int depth, std::vector<Trace> &data, bool sampleDiffuse,
+              PathType path) {
+    if (depth > 0) {
+        Hit h;
+        PJ_COUNT(COUNTER_RAYS);
+        bool flag = o->intersect(r, h, minTime);
+        if (flag) {
+            h.finalize(r);
+            Vector3f Ori = r.pointAtParameter(h.getT());
+            Vector3f specularPower = power * h.getMaterial()->specularRatio;
+            Vector3f diffusePower = power - specularPower;
+            // Planes and triangles keep one normal for both sides; turn it
+            // towards the ray so that the two sides of thin geometry differ.
+            Vector3f normal = h.getNormal();
+            if (Vector3f::dot(r.getDirection(), normal) > 0) {
+                normal = -normal;
+            }
+            if (diffusePower.length() > minPower) {
+                if (!h.getMaterial()->isBlack()) {
+                    Trace t;
+                    t.photon.pos = Ori;
+                    t.photon.dir = r.getDirection();
+                    t.photon.power = diffusePower;
+                    t.photon.normal = normal;
+                    t.photon.weight = 1;
+                    t.photon.cell = NO_EMISSION_CELL;
+                    t.material = h.getMaterial();
+                    t.caustic = path == PATH_CAUSTIC;
+                    data.push_back(t);
+                }
+                if (sampleDiffuse && random01() < 0.2) {
+                    // Diffuse
+                    Vector3f dir = randomDiffuse(normal);
+                    Ray diffuseRay(Ori, dir);
+                    traceRay(o, diffuseRay, diffusePower, depth - 1, data, sampleDiffuse, PATH_DIFFUSE);
+                }
+            }
+            if (specularPower.length() > minPower) {
+                PathType specularPath = path == PATH_DIFFUSE ? PATH_DIFFUSE : PATH_CAUSTIC;
+                float cosI = Vector3f::dot(r.getDirection(), h.getNormal());
+                float sinI = sqrt(1 - cosI * cosI);
+                float sinR;
+                Vector3f proj = cosI * h.getNormal();
+                Vector3f reflectionDir = r.getDirection() - 2 * proj;
+                if (cosI < 0) {
+                    // In-going ray
+                    sinR = sinI / h.getMaterial()->refraction;
+                }
+                else {
+                    // Out-going ray
+                    sinR = sinI * h.getMaterial()->refraction;
+                    if (sinR > 1) {
+                        // Total reflection
+                        traceRay(o, Ray(Ori, reflectionDir), specularPower, depth - 1, data, sampleDiffuse, specularPath);
+                    }
+                }
+                float cosR = sqrt(1 - sinR * sinR);
+                cosI = std::abs(cosI);
+                Vector3f refractionDir = (r.getDirection() - proj) * sinR / sinI + proj * cosR / cosI;
+                float sqrtRs = (cosI * sinR - sinI * cosR) / (cosI * sinR + sinI * cosR);
+                float sqrtRp = (cosI * cosR - sinI * sinR) / (cosI * cosR + sinI * sinR);
+                float R = (sqrtRs * sqrtRs + sqrtRp * sqrtRp) / 2, T = 1 - R;
+                traceRay(o, Ray(Ori, reflectionDir), specularPower * R, depth - 1, data, sampleDiffuse, specularPath);
+                traceRay(o, Ray(Ori, refractionDir), specularPower * T, depth - 1, data, sampleDiffuse, specularPath);
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+// A separate caustic map must only reduce noise: the image keeps the
+// brightness it has with a single photon map.
+
+#include "random.hpp"
+#include "test_common.hpp"
+
+const int PASSES = 10;
+
+float render(const std::string &scene, RenderEngine engine, int causticPhotons) {
+    seedRandom(1);
+    RenderSettings settings;
+    settings.engine = engine;
+    settings.spp = 2;
+    settings.photons = 20000;
+    settings.causticPhotons = causticPhotons;
+    Renderer renderer;
+    renderer.loadScene(scene.c_str());
+    renderer.configure(settings);
+    for (int passId = 0; passId < PASSES; ++passId) {
+        renderer.renderPass();
+    }
+    return meanRadiance(renderer.getFramebuffer());
+}
+
+int main(int argc, char *argv[]) {
+    std::string scene = scenePath(argc, argv, "caustic_box.txt");
+    for (RenderEngine engine: {ENGINE_PPM, ENGINE_SPPM}) {
+        float single = render(scene, engine, 0);
+        float separate = render(scene, engine, 20000);
+        printf("%s: one map %f, caustic map %f\n", engine == ENGINE_PPM ? "ppm" : "sppm", single, separate);
+        CHECK(std::abs(separate / single - 1) < 0.05f);
+    }
+    return testResult();
+}
@@ -0,0 +1,46 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <cstdio>
+#include <string>
+#include "image.hpp"
+#include "renderer.hpp"
+
+// Minimal checks for the ctest executables: failed checks are printed and
+// counted, and testResult() turns the count into the exit code.
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        ++failures; \
+    }
+
+inline int testResult() {
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("passed\n");
+    return 0;
+}
+
+// Mean of the three channels over all pixels
+inline float meanRadiance(const Image &image) {
+    double sum = 0;
+    for (int x = 0; x < image.Width(); ++x) {
+        for (int y = 0; y < image.Height(); ++y) {
+            const Vector3f &pixel = image.GetPixel(x, y);
+            sum += pixel[0] + pixel[1] + pixel[2];
+        }
+    }
+    return (float) (sum / (3.0 * image.Width() * image.Height()));
+}
+
+// Scene files are found in the directory given as the first argument.
+inline std::string scenePath(int argc, char *argv[], const char *name) {
+    return std::string(argc > 1 ? argv[1] : "tests/scenes") + "/" + name;
+}
+
+#endif // TEST_COMMON_H
@@ -0,0 +1,56 @@
+// Compact photons must round-trip direction, normal, power and weight
+// closely enough that the map stays unbiased.
+
+#include <cmath>
+#include <random>
+
+#include "photon.hpp"
+#include "test_common.hpp"
+
+int main() {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(-1, 1);
+    std::uniform_real_distribution<float> exponent(-20, 20);
+    float dirError = 0, normalError = 0, powerError = 0, weightError = 0;
+    for (int i = 0; i < 100000; ++i) {
+        Photon p;
+        p.pos = Vector3f(uniform(rng), uniform(rng), uniform(rng));
+        p.dir = Vector3f(uniform(rng), uniform(rng), uniform(rng)).normalized();
+        p.normal = Vector3f(uniform(rng), uniform(rng), uniform(rng)).normalized();
+        p.power = Vector3f(uniform(rng) + 1, uniform(rng) + 1, uniform(rng) + 1) * std::exp2(exponent(rng));
+        p.weight = std::exp2(exponent(rng));
+        p.cell = (unsigned short) i;
+
+        CompactPhoton stored;
+        encodePhoton(p, stored);
+        Photon q = decodePhoton(stored);
+        CHECK(q.pos == p.pos && q.cell == p.cell);
+        dirError = std::max(dirError, std::acos(std::min(1.0f, Vector3f::dot(p.dir, q.dir))));
+        normalError = std::max(normalError, std::acos(std::min(1.0f, Vector3f::dot(p.normal, q.normal))));
+        float m = std::max(p.power[0], std::max(p.power[1], p.power[2]));
+        powerError = std::max(powerError, (q.power - p.power).squaredLength() / (m * m));
+        weightError = std::max(weightError, std::abs(q.weight / p.weight - 1));
+    }
+    printf("max errors: dir %g rad, normal %g rad, power %g, weight %g\n",
+           dirError, normalError, std::sqrt(powerError), weightError);
+    CHECK(dirError < 5e-3f);
+    CHECK(normalError < 0.1f);
+    CHECK(std::sqrt(powerError) < 0.01f);
+    CHECK(weightError <= 1.0f / 2048);
+
+    // Whole weights of the light shares are exact up to 2^11.
+    for (int w = 1; w <= 2048; ++w) {
+        CHECK(decodeWeight(encodeWeight((float) w)) == w);
+    }
+    CHECK(decodeWeight(encodeWeight(0)) == 0);
+
+    CompactPhoton stored;
+    Photon p;
+    p.pos = p.dir = p.power = Vector3f::ZERO;
+    p.normal = Vector3f::ZERO;
+    p.weight = 1;
+    p.cell = NO_EMISSION_CELL;
+    encodePhoton(p, stored);
+    CHECK(photonNormal(stored) == Vector3f::ZERO);
+    return testResult();
+}
@@ -0,0 +1,37 @@
+// Guided emission must only move photons to where they are seen: guided
+// and plain emission render the same mean brightness, for area and point
+// lights.
+
+#include "random.hpp"
+#include "test_common.hpp"
+
+const int PASSES = 20;
+
+float render(const std::string &scene, RenderEngine engine, bool guided) {
+    seedRandom(1);
+    RenderSettings settings;
+    settings.engine = engine;
+    settings.spp = 2;
+    settings.photons = 20000;
+    settings.guided = guided;
+    Renderer renderer;
+    renderer.loadScene(scene.c_str());
+    renderer.configure(settings);
+    for (int passId = 0; passId < PASSES; ++passId) {
+        renderer.renderPass();
+    }
+    return meanRadiance(renderer.getFramebuffer());
+}
+
+int main(int argc, char *argv[]) {
+    for (const char *name: {"caustic_box.txt", "point_box.txt"}) {
+        std::string scene = scenePath(argc, argv, name);
+        for (RenderEngine engine: {ENGINE_PPM, ENGINE_SPPM}) {
+            float plain = render(scene, engine, false);
+            float guided = render(scene, engine, true);
+            printf("%s %s: plain %f, guided %f\n", name, engine == ENGINE_PPM ? "ppm" : "sppm", plain, guided);
+            CHECK(std::abs(guided / plain - 1) < 0.05f);
+        }
+    }
+    return testResult();
+}
@@ -0,0 +1,30 @@
+// Sharing the photons among lights by power must not change the image: two
+// mirrored halves of a scene, split by a black wall and lit by lights of
+// 3:1 power, keep a 3:1 brightness.
+
+#include "random.hpp"
+#include "test_common.hpp"
+
+const int PASSES = 10;
+
+int main(int argc, char *argv[]) {
+    std::string scene = scenePath(argc, argv, "two_lights.txt");
+    for (RenderEngine engine: {ENGINE_PPM, ENGINE_SPPM}) {
+        seedRandom(1);
+        RenderSettings settings;
+        settings.engine = engine;
+        settings.spp = 2;
+        settings.photons = 20000;
+        Renderer renderer;
+        renderer.loadScene(scene.c_str());
+        renderer.configure(settings);
+        for (int passId = 0; passId < PASSES; ++passId) {
+            renderer.renderPass();
+        }
+        float bright = meanRadiance(renderer.getFramebuffer(0));
+        float dim = meanRadiance(renderer.getFramebuffer(1));
+        printf("%s: bright side %f, dim side %f\n", engine == ENGINE_PPM ? "ppm" : "sppm", bright, dim);
+        CHECK(std::abs(dim / bright * 3 - 1) < 0.05f);
+    }
+    return testResult();
+}
@@ -0,0 +1,59 @@
+// Photons on one side of a thin two-sided wall must not be gathered by hit
+// points on the other side.
+
+#include <vector>
+
+#include "group.hpp"
+#include "material.hpp"
+#include "photon_kdtree.hpp"
+#include "plane.hpp"
+#include "tracer.hpp"
+#include "triangle.hpp"
+#include "test_common.hpp"
+
+// The first diffuse Trace of a ray from origin along dir.
+Trace traceFirst(Object3D *o, const Vector3f &origin, const Vector3f &dir) {
+    std::vector<Trace> trace;
+    traceRay(o, Ray(origin, dir), Vector3f(1), 1, trace, false);
+    CHECK(trace.size() == 1);
+    return trace.empty() ? Trace() : trace[0];
+}
+
+// Photons arrive at the wall x = 0 from -x; count what view rays from
+// either side gather there.
+void checkWall(const char *name, Object3D *wall) {
+    printf("%s\n", name);
+    std::vector<Photon> photons;
+    for (int i = 0; i < 4; ++i) {
+        Vector3f target(0, 0.01f * i, 0.01f * i);
+        photons.push_back(traceFirst(wall, Vector3f(-1, 0, 0), (target - Vector3f(-1, 0, 0)).normalized()).photon);
+    }
+    PhotonKDTree tree;
+    tree.build(photons.begin(), photons.end(), 0);
+
+    Trace lit = traceFirst(wall, Vector3f(-2, 0, 0), Vector3f(1, 0, 0));
+    Trace dark = traceFirst(wall, Vector3f(2, 0, 0), Vector3f(-1, 0, 0));
+    CHECK(Vector3f::dot(lit.photon.normal, Vector3f(-1, 0, 0)) > 0.99f);
+    CHECK(Vector3f::dot(dark.photon.normal, Vector3f(1, 0, 0)) > 0.99f);
+
+    std::vector<Photon> collected;
+    tree.collect(lit.photon.pos, 0.1f, collected, lit.photon.normal);
+    CHECK(collected.size() == photons.size());
+    collected.clear();
+    tree.collect(dark.photon.pos, 0.1f, collected, dark.photon.normal);
+    CHECK(collected.empty());
+}
+
+int main() {
+    Material material(Vector3f(0.8f));
+    // Normal +x, facing away from the photons
+    Group triangles(2);
+    triangles.addObject(0, new Triangle(Vector3f(0, -1, -1), Vector3f(0, 1, -1), Vector3f(0, 1, 1), &material));
+    triangles.addObject(1, new Triangle(Vector3f(0, -1, -1), Vector3f(0, 1, 1), Vector3f(0, -1, 1), &material));
+    checkWall("triangle wall", &triangles);
+    // Normal -x, facing the photons
+    Plane plane(Vector3f(-1, 0, 0), 0, &material);
+    checkWall("plane wall", &plane);
+
+    return testResult();
+}